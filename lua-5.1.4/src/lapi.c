@@ -926,7 +926,7 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
       res = cast_int(g->totalbytes & 0x3ff);
       break;
     }
-    case LUA_GCSTEP: 
+    case LUA_GCSTEP: {
 	  // dataΪҪֽk bytesΪλ
       lu_mem a = (cast(lu_mem, data) << 10);  // Ŵ1024
       if (a <= g->totalbytes)
@@ -954,6 +954,22 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
       g->gcstepmul = data;
       break;
     }
+    case LUA_GCSTACKREALLOC: {
+      res = cast_int(g->nstackrealloc);
+      break;
+    }
+    case LUA_GCCIREALLOC: {
+      res = cast_int(g->ncirealloc);
+      break;
+    }
+    case LUA_GCTHREADREUSE: {
+      res = cast_int(g->nthreadreuse);
+      break;
+    }
+    case LUA_GCTHREADPOOL: {
+      res = g->nthreadpool;
+      break;
+    }
     default: res = -1;  /* invalid option */
   }
   lua_unlock(L);
@@ -1042,7 +1058,7 @@ LUA_API void *lua_newuserdata (lua_State *L, size_t size) {
 
 
 
-static const char *aux_upvalue (StkId fi, int n, TValue **val) {
+static const char *aux_upvalue (lua_State *L, StkId fi, int n, TValue **val) {
   Closure *f;
   if (!ttisfunction(fi)) return NULL;
   f = clvalue(fi);
@@ -1053,6 +1069,7 @@ static const char *aux_upvalue (StkId fi, int n, TValue **val) {
   }
   else {
     Proto *p = f->l.p;
+    luaU_needdebug(L, p);
     if (!(1 <= n && n <= p->sizeupvalues)) return NULL;
     *val = f->l.upvals[n-1]->v;
     return getstr(p->upvalues[n-1]);
@@ -1064,7 +1081,7 @@ LUA_API const char *lua_getupvalue (lua_State *L, int funcindex, int n) {
   const char *name;
   TValue *val;
   lua_lock(L);
-  name = aux_upvalue(index2adr(L, funcindex), n, &val);
+  name = aux_upvalue(L, index2adr(L, funcindex), n, &val);
   if (name) {
     setobj2s(L, L->top, val);
     api_incr_top(L);
@@ -1081,7 +1098,7 @@ LUA_API const char *lua_setupvalue (lua_State *L, int funcindex, int n) {
   lua_lock(L);
   fi = index2adr(L, funcindex);
   api_checknelems(L, 1);
-  name = aux_upvalue(fi, n, &val);
+  name = aux_upvalue(L, fi, n, &val);
   if (name) {
     L->top--;
     setobj(L, val, L->top);
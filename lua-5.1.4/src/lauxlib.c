@@ -644,9 +644,28 @@ static int panic (lua_State *L) {
 }
 
 
+/*
+** reads the debug information that `luac -d' wrote to a side file
+*/
+static int debugloader (void *ud, const char *name, size_t offset,
+                        size_t size, char *buff) {
+  FILE *f = fopen(name, "rb");
+  int ok;
+  (void)ud;
+  if (f == NULL) return 0;
+  ok = fseek(f, (long)offset, SEEK_SET) == 0 &&
+       fread(buff, 1, size, f) == size;
+  fclose(f);
+  return ok;
+}
+
+
 LUALIB_API lua_State *luaL_newstate (void) {
   lua_State *L = lua_newstate(l_alloc, NULL);
-  if (L) lua_atpanic(L, &panic);
+  if (L) {
+    lua_atpanic(L, &panic);
+    lua_setdebugloader(L, &debugloader, NULL);
+  }
   return L;
 }
 
@@ -192,9 +192,11 @@ static int luaB_gcinfo (lua_State *L) {
 
 static int luaB_collectgarbage (lua_State *L) {
   static const char *const opts[] = {"stop", "restart", "collect",
-    "count", "step", "setpause", "setstepmul", NULL};
+    "count", "step", "setpause", "setstepmul", "stackrealloc", "cirealloc",
+    "threadreuse", "threadpool", NULL};
   static const int optsnum[] = {LUA_GCSTOP, LUA_GCRESTART, LUA_GCCOLLECT,
-    LUA_GCCOUNT, LUA_GCSTEP, LUA_GCSETPAUSE, LUA_GCSETSTEPMUL};
+    LUA_GCCOUNT, LUA_GCSTEP, LUA_GCSETPAUSE, LUA_GCSETSTEPMUL,
+    LUA_GCSTACKREALLOC, LUA_GCCIREALLOC, LUA_GCTHREADREUSE, LUA_GCTHREADPOOL};
   int o = luaL_checkoption(L, 1, "collect", opts);
   int ex = luaL_optint(L, 2, 0);
   int res = lua_gc(L, optsnum[o], ex);
@@ -357,6 +359,10 @@ static int luaB_unpack (lua_State *L) {
 
 static int luaB_select (lua_State *L) {
   int n = lua_gettop(L);
+  if (lua_type(L, 1) == LUA_TNUMBER) {  /* common case: select(i, ...) */
+    int i = (int)lua_tointeger(L, 1);
+    if (1 <= i && i < n) return n - i;
+  }
   if (lua_type(L, 1) == LUA_TSTRING && *lua_tostring(L, 1) == '#') {
     lua_pushinteger(L, n-1);
     return 1;
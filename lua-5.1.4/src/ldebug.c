@@ -26,6 +26,7 @@
 #include "lstring.h"
 #include "ltable.h"
 #include "ltm.h"
+#include "lundump.h"
 #include "lvm.h"
 
 
@@ -45,8 +46,11 @@ static int currentline (lua_State *L, CallInfo *ci) {
   int pc = currentpc(L, ci);
   if (pc < 0)
     return -1;  /* only active lua functions have current-line information */
-  else
-    return getline(ci_func(ci)->l.p, pc);
+  else {
+    Proto *p = ci_func(ci)->l.p;
+    luaU_needdebug(L, p);
+    return getline(p, pc);
+  }
 }
 
 
@@ -81,6 +85,14 @@ LUA_API int lua_gethookcount (lua_State *L) {
 }
 
 
+LUA_API void lua_setdebugloader (lua_State *L, lua_DebugLoader f, void *ud) {
+  lua_lock(L);
+  G(L)->debugloader = f;
+  G(L)->debugud = ud;
+  lua_unlock(L);
+}
+
+
 LUA_API int lua_getstack (lua_State *L, int level, lua_Debug *ar) {
   int status;
   CallInfo *ci;
@@ -112,6 +124,7 @@ static Proto *getluaproto (CallInfo *ci) {
 static const char *findlocal (lua_State *L, CallInfo *ci, int n) {
   const char *name;
   Proto *fp = getluaproto(ci);
+  if (fp) luaU_needdebug(L, fp);
   if (fp && (name = luaF_getlocalname(fp, n, currentpc(L, ci))) != NULL)
     return name;  /* is a local variable in a Lua function */
   else {
@@ -180,8 +193,10 @@ static void collectvalidlines (lua_State *L, Closure *f) {
   }
   else {
     Table *t = luaH_new(L, 0, 0);
-    int *lineinfo = f->l.p->lineinfo;
+    int *lineinfo;
     int i;
+    luaU_needdebug(L, f->l.p);
+    lineinfo = f->l.p->lineinfo;
     for (i=0; i<f->l.p->sizelineinfo; i++)
       setbvalue(luaH_setnum(L, t, lineinfo[i]), 1);
     sethvalue(L, L->top, t); 
@@ -500,6 +515,7 @@ static const char *getobjname (lua_State *L, CallInfo *ci, int stackpos,
     Proto *p = ci_func(ci)->l.p;
     int pc = currentpc(L, ci);
     Instruction i;
+    luaU_needdebug(L, p);
     *name = luaF_getlocalname(p, stackpos+1, pc);
     if (*name)  /* is a local? */
       return "local";
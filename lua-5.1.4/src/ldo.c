@@ -140,12 +140,21 @@ static void correctstack (lua_State *L, TValue *oldstack) {
 
 void luaD_reallocstack (lua_State *L, int newsize) {
   TValue *oldstack = L->stack;
+  int oldsize = L->stacksize;
   int realsize = newsize + 1 + EXTRA_STACK;
   lua_assert(L->stack_last - L->stack == L->stacksize - EXTRA_STACK - 1);
-  luaM_reallocvector(L, L->stack, L->stacksize, realsize, TValue);
+  if (realsize < oldsize)  /* shrinking? move upvalue map down first */
+    memmove(L->stack + realsize, upvalmap(L), realsize * sizeof(UpVal *));
+  L->stack = cast(TValue *, luaM_realloc_(L, L->stack,
+                  oldsize * STACKSLOT_SIZE, realsize * STACKSLOT_SIZE));
   L->stacksize = realsize;
+  if (realsize > oldsize) {  /* growing? move upvalue map up and clear tail */
+    memmove(upvalmap(L), L->stack + oldsize, oldsize * sizeof(UpVal *));
+    memset(upvalmap(L) + oldsize, 0, (realsize - oldsize) * sizeof(UpVal *));
+  }
   L->stack_last = L->stack+newsize;
   correctstack(L, oldstack);
+  G(L)->nstackrealloc++;
 }
 
 
@@ -155,6 +164,7 @@ void luaD_reallocCI (lua_State *L, int newsize) {
   L->size_ci = newsize;
   L->ci = (L->ci - oldci) + L->base_ci;
   L->end_ci = L->base_ci + L->size_ci - 1;
+  G(L)->ncirealloc++;
 }
 
 
@@ -280,6 +290,8 @@ int luaD_precall (lua_State *L, StkId func, int nresults) {
       if (L->top > base + p->numparams)
         L->top = base + p->numparams;
     }
+    else if (p->numparams == 0 && !(p->is_vararg & VARARG_NEEDSARG))
+      base = L->top;  /* only varargs: they stay where they are */
     else {  /* vararg function */
       int nargs = cast_int(L->top - func) - 1;
       base = adjust_varargs(L, p, nargs);
@@ -5,6 +5,7 @@
 */
 
 #include <stddef.h>
+#include <string.h>
 
 #define ldump_c
 #define LUA_CORE
@@ -21,6 +22,11 @@ typedef struct {
  void* data;
  int strip;
  int status;
+ size_t size;			/* bytes written through `writer' */
+ lua_Writer dwriter;		/* writer for the side file, if any */
+ void* ddata;
+ const char* dname;		/* side file name recorded in the chunk */
+ size_t dsize;			/* bytes written to the side file */
 } DumpState;
 
 #define DumpMem(b,n,size,D)	DumpBlock(b,(n)*(size),D)
@@ -34,6 +40,7 @@ static void DumpBlock(const void* b, size_t size, DumpState* D)
   D->status=(*D->writer)(D->L,b,size,D->data);
   lua_lock(D->L);
  }
+ D->size+=size;
 }
 
 static void DumpChar(int y, DumpState* D)
@@ -108,7 +115,22 @@ static void DumpConstants(const Proto* f, DumpState* D)
  for (i=0; i<n; i++) DumpFunction(f->p[i],f->source,D);
 }
 
-static void DumpDebug(const Proto* f, DumpState* D)
+static void DumpCString(const char* s, DumpState* D)
+{
+ size_t size=strlen(s)+1;		/* include trailing '\0' */
+ DumpVar(size,D);
+ DumpBlock(s,size,D);
+}
+
+static void DumpSplitDebug(const char* file, size_t offset, size_t size, DumpState* D)
+{
+ DumpInt(LUAC_SPLITDEBUG,D);
+ DumpCString(file,D);
+ DumpInt((int)offset,D);
+ DumpInt((int)size,D);
+}
+
+static void DumpDebugInfo(const Proto* f, DumpState* D)
 {
  int i,n;
  n= (D->strip) ? 0 : f->sizelineinfo;
@@ -126,6 +148,28 @@ static void DumpDebug(const Proto* f, DumpState* D)
  for (i=0; i<n; i++) DumpString(f->upvalues[i],D);
 }
 
+static void DumpDebug(const Proto* f, DumpState* D)
+{
+ if (D->strip)
+  DumpDebugInfo(f,D);
+ else if (D->dwriter!=NULL)		/* write it to the side file */
+ {
+  lua_Writer w=D->writer;
+  void* data=D->data;
+  size_t size=D->size;
+  size_t offset=D->dsize;
+  D->writer=D->dwriter; D->data=D->ddata; D->size=offset;
+  DumpDebugInfo(f,D);
+  D->dsize=D->size;
+  D->writer=w; D->data=data; D->size=size;
+  DumpSplitDebug(D->dname,offset,D->dsize-offset,D);
+ }
+ else if (f->debugfile!=NULL)		/* still in its own side file */
+  DumpSplitDebug(getstr(f->debugfile),f->debugoffset,f->debugsize,D);
+ else
+  DumpDebugInfo(f,D);
+}
+
 static void DumpFunction(const Proto* f, const TString* p, DumpState* D)
 {
  DumpString((f->source==p || D->strip) ? NULL : f->source,D);
@@ -158,6 +202,34 @@ int luaU_dump (lua_State* L, const Proto* f, lua_Writer w, void* data, int strip
  D.data=data;
  D.strip=strip;
  D.status=0;
+ D.size=0;
+ D.dwriter=NULL;
+ D.ddata=NULL;
+ D.dname=NULL;
+ D.dsize=0;
+ DumpHeader(&D);
+ DumpFunction(f,NULL,&D);
+ return D.status;
+}
+
+/*
+** dump Lua function as precompiled chunk, with its debug information
+** written through `dw' and loaded from file `dname' when needed
+*/
+int luaU_dumpsplit (lua_State* L, const Proto* f, lua_Writer w, void* data,
+                    lua_Writer dw, void* ddata, const char* dname)
+{
+ DumpState D;
+ D.L=L;
+ D.writer=w;
+ D.data=data;
+ D.strip=0;
+ D.status=0;
+ D.size=0;
+ D.dwriter=dw;
+ D.ddata=ddata;
+ D.dname=dname;
+ D.dsize=0;
  DumpHeader(&D);
  DumpFunction(f,NULL,&D);
  return D.status;
@@ -53,15 +53,17 @@ UpVal *luaF_newupval (lua_State *L) {
 UpVal *luaF_findupval (lua_State *L, StkId level) {
   global_State *g = G(L);
   GCObject **pp = &L->openupval;
-  UpVal *p;
+  UpVal **slot = &upvalmap(L)[level - L->stack];
+  UpVal *p = *slot;
   UpVal *uv;
-  while (*pp != NULL && (p = ngcotouv(*pp))->v >= level) {
+  if (p != NULL) {  /* found a corresponding upvalue? */
+    lua_assert(p->v == level);
+    if (isdead(g, obj2gco(p)))  /* is it dead? */
+      changewhite(obj2gco(p));  /* ressurect it */
+    return p;
+  }
+  while (*pp != NULL && (p = ngcotouv(*pp))->v > level) {
     lua_assert(p->v != &p->u.value);
-    if (p->v == level) {  /* found a corresponding upvalue? */
-      if (isdead(g, obj2gco(p)))  /* is it dead? */
-        changewhite(obj2gco(p));  /* ressurect it */
-      return p;
-    }
     pp = &p->next;
   }
   uv = luaM_new(L, UpVal);  /* not found: create a new one */
@@ -70,6 +72,7 @@ UpVal *luaF_findupval (lua_State *L, StkId level) {
   uv->v = level;  /* current value lives in the stack */
   uv->next = *pp;  /* chain it in the proper position */
   *pp = obj2gco(uv);
+  *slot = uv;
   uv->u.l.prev = &g->uvhead;  /* double link it in `uvhead' list */
   uv->u.l.next = g->uvhead.u.l.next;
   uv->u.l.next->u.l.prev = uv;
@@ -100,6 +103,7 @@ void luaF_close (lua_State *L, StkId level) {
     GCObject *o = obj2gco(uv);
     lua_assert(!isblack(o) && uv->v != &uv->u.value);
     L->openupval = uv->next;  /* remove from `open' list */
+    upvalmap(L)[uv->v - L->stack] = NULL;
     if (isdead(g, o))
       luaF_freeupval(L, uv);  /* free upvalue */
     else {
@@ -134,6 +138,9 @@ Proto *luaF_newproto (lua_State *L) {
   f->linedefined = 0;
   f->lastlinedefined = 0;
   f->source = NULL;
+  f->debugfile = NULL;
+  f->debugoffset = 0;
+  f->debugsize = 0;
   return f;
 }
 
@@ -204,6 +204,7 @@ static int traversetable (global_State *g, Table *h) {
 static void traverseproto (global_State *g, Proto *f) {
   int i;
   if (f->source) stringmark(f->source);
+  if (f->debugfile) stringmark(f->debugfile);
   for (i=0; i<f->sizek; i++)  /* mark literals */
     markvalue(g, &f->k[i]);
   for (i=0; i<f->sizeupvalues; i++) {  /* mark upvalue names */
@@ -404,6 +405,18 @@ static void freeobj (lua_State *L, GCObject *o) {
 
 #define sweepwholelist(L,p)	sweeplist(L,p,MAX_LUMEM)
 
+static GCObject **sweeplist (lua_State *L, GCObject **p, lu_mem count);
+
+
+static void sweepopenupval (lua_State *L, lua_State *th) {
+  global_State *g = G(L);
+  GCObject *o;
+  for (o = th->openupval; o != NULL; o = o->gch.next)
+    if (isdead(g, o))  /* about to be freed? forget its stack slot */
+      upvalmap(th)[gco2uv(o)->v - th->stack] = NULL;
+  sweepwholelist(L, &th->openupval);
+}
+
 
 static GCObject **sweeplist (lua_State *L, GCObject **p, lu_mem count) {
   GCObject *curr;
@@ -411,7 +424,7 @@ static GCObject **sweeplist (lua_State *L, GCObject **p, lu_mem count) {
   int deadmask = otherwhite(g);
   while ((curr = *p) != NULL && count-- > 0) {
     if (curr->gch.tt == LUA_TTHREAD)  /* sweep open upvalues of each thread */
-      sweepwholelist(L, &gco2th(curr)->openupval);
+      sweepopenupval(L, gco2th(curr));
     if ((curr->gch.marked ^ WHITEBITS) & deadmask) {  /* not dead? */
       lua_assert(!isdead(g, curr) || testbit(curr->gch.marked, FIXEDBIT));
       makewhite(g, curr);  /* make it white (for next cycle) */
@@ -288,6 +288,65 @@ static int test_eof (lua_State *L, FILE *f) {
 }
 
 
+#if defined(lua_getline)
+
+/*
+** Line buffer shared by all reads of the library. 'lua_getline' scans
+** the stream buffer for the newline and copies the line in one pass,
+** and the line is then pushed straight from this buffer, so a line is
+** never split into pieces that must be concatenated afterwards.
+*/
+typedef struct LineBuf {
+  char *p;
+  size_t size;
+} LineBuf;
+
+
+static int linebuf_gc (lua_State *L) {
+  LineBuf *lb = (LineBuf *)lua_touserdata(L, 1);
+  free(lb->p);
+  lb->p = NULL;
+  lb->size = 0;
+  return 0;
+}
+
+
+static void createlinebuf (lua_State *L) {
+  LineBuf *lb = (LineBuf *)lua_newuserdata(L, sizeof(LineBuf));
+  lb->p = NULL;
+  lb->size = 0;
+  lua_createtable(L, 0, 1);
+  lua_pushcfunction(L, linebuf_gc);
+  lua_setfield(L, -2, "__gc");
+  lua_setmetatable(L, -2);
+  lua_pushlightuserdata(L, (void *)&linebuf_gc);  /* key */
+  lua_insert(L, -2);
+  lua_rawset(L, LUA_REGISTRYINDEX);
+}
+
+
+static int read_line (lua_State *L, FILE *f) {
+  LineBuf *lb;
+  long l;
+  lua_pushlightuserdata(L, (void *)&linebuf_gc);
+  lua_rawget(L, LUA_REGISTRYINDEX);
+  lb = (LineBuf *)lua_touserdata(L, -1);
+  lua_pop(L, 1);  /* buffer is kept alive by the registry */
+  l = lua_getline(L, &lb->p, &lb->size, f);
+  if (l <= 0) {  /* eof? */
+    if (!feof(f) && !ferror(f))  /* could not grow the buffer? */
+      luaL_error(L, "not enough memory to read line");
+    lua_pushlstring(L, NULL, 0);
+    return 0;
+  }
+  if (lb->p[l-1] == '\n')
+    l--;  /* do not include `eol' */
+  lua_pushlstring(L, lb->p, (size_t)l);
+  return 1;  /* read at least an `eol' */
+}
+
+#else
+
 static int read_line (lua_State *L, FILE *f) {
   luaL_Buffer b;
   luaL_buffinit(L, &b);
@@ -309,6 +368,8 @@ static int read_line (lua_State *L, FILE *f) {
   }
 }
 
+#endif
+
 
 static int read_chars (lua_State *L, FILE *f, size_t n) {
   size_t rlen;  /* how much to read */
@@ -404,6 +465,42 @@ static int io_readline (lua_State *L) {
   }
 }
 
+
+/*
+** file:readlines([n [, t]]) reads up to 'n' lines into 't[1..k]' (a new
+** table when 't' is absent) and returns 't' and 'k', or nil at end of
+** file. Reusing 't' across calls lets a loop over a large file pay one
+** call per batch instead of one call per line.
+*/
+static int f_readlines (lua_State *L) {
+  FILE *f = tofile(L);
+  int n = luaL_optint(L, 2, LUA_MINSTACK);
+  int k = 0;
+  luaL_argcheck(L, n > 0, 2, "positive batch size expected");
+  if (lua_isnoneornil(L, 3))
+    lua_createtable(L, n, 0);
+  else {
+    luaL_checktype(L, 3, LUA_TTABLE);
+    lua_pushvalue(L, 3);
+  }
+  clearerr(f);
+  while (k < n) {
+    if (!read_line(L, f)) {
+      lua_pop(L, 1);  /* remove empty result */
+      break;
+    }
+    lua_rawseti(L, -2, ++k);
+  }
+  if (ferror(f))
+    return pushresult(L, 0, NULL);
+  if (k == 0) {  /* EOF */
+    lua_pushnil(L);
+    return 1;
+  }
+  lua_pushinteger(L, k);
+  return 2;
+}
+
 /* }====================================================== */
 
 
@@ -495,6 +592,7 @@ static const luaL_Reg flib[] = {
   {"flush", f_flush},
   {"lines", f_lines},
   {"read", f_read},
+  {"readlines", f_readlines},
   {"seek", f_seek},
   {"setvbuf", f_setvbuf},
   {"write", f_write},
@@ -536,6 +634,9 @@ LUALIB_API int luaopen_io (lua_State *L) {
   /* create (private) environment (with fields IO_INPUT, IO_OUTPUT, __close) */
   newfenv(L, io_fclose);
   lua_replace(L, LUA_ENVIRONINDEX);
+#if defined(lua_getline)
+  createlinebuf(L);
+#endif
   /* open library */
   luaL_register(L, LUA_IOLIBNAME, iolib);
   /* create (and set) default files */
@@ -41,10 +41,15 @@
 
 #define setprogdir(L)		((void)0)
 
+/* maximum depth of subdirectories package.buildindex can be asked to scan */
+#define MAXINDEXDEPTH	16
+
 
 static void ll_unloadlib (void *lib);
 static void *ll_load (lua_State *L, const char *path);
 static lua_CFunction ll_sym (lua_State *L, void *lib, const char *sym);
+static int listfiles (lua_State *L, const char *dir, const char *rel,
+                                    int t, int depth);
 
 
 
@@ -259,6 +264,90 @@ static lua_CFunction ll_sym (lua_State *L, void *lib, const char *sym) {
 
 
 
+/*
+** {======================================================
+** Directory listing for the module index
+** =======================================================
+*/
+
+
+static void addfile (lua_State *L, const char *rel, const char *name, int t) {
+  lua_pushfstring(L, "%s%s", rel, name);
+  lua_rawseti(L, t, lua_objlen(L, t) + 1);
+}
+
+
+static void listsubdir (lua_State *L, const char *dir, const char *rel,
+                                      const char *name, int t, int depth) {
+  if (depth <= 0) return;  /* too deep; ignore it */
+  luaL_checkstack(L, 2, "too many nested directories");
+  lua_pushfstring(L, "%s%s" LUA_DIRSEP, dir, name);
+  lua_pushfstring(L, "%s%s" LUA_DIRSEP, rel, name);
+  listfiles(L, lua_tostring(L, -2), lua_tostring(L, -1), t, depth - 1);
+  lua_pop(L, 2);
+}
+
+
+#if defined(LUA_USE_POSIX)
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+static int listfiles (lua_State *L, const char *dir, const char *rel,
+                                    int t, int depth) {
+  DIR *d = opendir((*dir == '\0') ? "." : dir);
+  struct dirent *e;
+  if (d == NULL) return 0;
+  while ((e = readdir(d)) != NULL) {
+    struct stat st;
+    if (e->d_name[0] == '.') continue;  /* skip `.', `..' and hidden files */
+    if (stat(lua_pushfstring(L, "%s%s", dir, e->d_name), &st) == 0) {
+      if (S_ISREG(st.st_mode))
+        addfile(L, rel, e->d_name, t);
+      else if (S_ISDIR(st.st_mode))
+        listsubdir(L, dir, rel, e->d_name, t, depth);
+    }
+    lua_pop(L, 1);
+  }
+  closedir(d);
+  return 1;
+}
+
+#elif defined(LUA_DL_DLL)
+
+static int listfiles (lua_State *L, const char *dir, const char *rel,
+                                    int t, int depth) {
+  WIN32_FIND_DATAA fd;
+  HANDLE h = FindFirstFileA(lua_pushfstring(L, "%s*", dir), &fd);
+  lua_pop(L, 1);
+  if (h == INVALID_HANDLE_VALUE) return 0;
+  do {
+    if (fd.cFileName[0] == '.') continue;  /* skip `.', `..' and hidden files */
+    if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      listsubdir(L, dir, rel, fd.cFileName, t, depth);
+    else
+      addfile(L, rel, fd.cFileName, t);
+  } while (FindNextFileA(h, &fd));
+  FindClose(h);
+  return 1;
+}
+
+#else
+
+#define LISTMSG	"directory listing not enabled; check your Lua installation"
+
+static int listfiles (lua_State *L, const char *dir, const char *rel,
+                                    int t, int depth) {
+  (void)L; (void)dir; (void)rel; (void)t; (void)depth;  /* to avoid warnings */
+  return 0;
+}
+
+#endif
+
+/* }====================================================== */
+
+
+
 static void **ll_register (lua_State *L, const char *path) {
   void **plib;
   lua_pushfstring(L, "%s%s", LIBPREFIX, path);
@@ -377,9 +466,155 @@ static void loaderror (lua_State *L, const char *filename) {
 }
 
 
+/*
+** The module index maps module names to file names (or directly to
+** loaders), so that `require' can find Lua modules without probing
+** every template in `package.path'.
+*/
+
+typedef struct IndexStats {
+  unsigned long lookups;
+  unsigned long misses;
+} IndexStats;
+
+
+static IndexStats *getindexstats (lua_State *L) {
+  IndexStats *s;
+  lua_getfield(L, LUA_REGISTRYINDEX, "_INDEXSTATS");
+  s = (IndexStats *)lua_touserdata(L, -1);
+  lua_pop(L, 1);  /* registry keeps it alive */
+  return s;
+}
+
+
+/*
+** lists the files below `root' (relative to it), once per root, going
+** down at most `depth' levels of subdirectories
+*/
+static int getfiles (lua_State *L, const char *root, int cache, int depth) {
+  lua_getfield(L, cache, root);
+  if (lua_isnil(L, -1)) {  /* not listed yet? */
+    lua_pop(L, 1);
+    lua_newtable(L);
+    listfiles(L, root, "", lua_gettop(L), depth);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, cache, root);
+  }
+  return lua_gettop(L);
+}
+
+
+/* adds to the index the modules that template `tmpl' can find */
+static int indextemplate (lua_State *L, const char *tmpl, int idx, int cache,
+                                         int depth) {
+  const char *mark = strchr(tmpl, *LUA_PATH_MARK);
+  const char *base = tmpl;
+  const char *suffix, *p;
+  size_t prelen, suflen;
+  int files, i;
+  int n = 0;
+  if (mark == NULL || strchr(mark + 1, *LUA_PATH_MARK) != NULL)
+    return 0;  /* names cannot be read back from this template */
+  for (p = tmpl; p < mark; p++)  /* find the directory part of the prefix */
+    if (*p == *LUA_DIRSEP) base = p + 1;
+  lua_pushlstring(L, tmpl, base - tmpl);  /* root directory */
+  files = getfiles(L, lua_tostring(L, -1), cache, depth);
+  prelen = mark - base;
+  suffix = mark + 1;
+  suflen = strlen(suffix);
+  for (i = 1; ; i++) {
+    size_t l;
+    const char *f;
+    lua_rawgeti(L, files, i);
+    f = lua_tolstring(L, -1, &l);
+    if (f == NULL) break;  /* no more files */
+    if (l > prelen + suflen && strncmp(f, base, prelen) == 0 &&
+        strcmp(f + l - suflen, suffix) == 0 &&
+        memchr(f + prelen, '.', l - prelen - suflen) == NULL) {
+      lua_pushlstring(L, f + prelen, l - prelen - suflen);
+      luaL_gsub(L, lua_tostring(L, -1), LUA_DIRSEP, ".");  /* module name */
+      lua_remove(L, -2);
+      lua_pushvalue(L, -1);
+      lua_rawget(L, idx);
+      if (lua_isnil(L, -1)) {  /* earlier templates take precedence */
+        lua_pop(L, 1);
+        lua_pushfstring(L, "%s%s", lua_tostring(L, files - 1), f);
+        lua_rawset(L, idx);
+        n++;
+      }
+      else lua_pop(L, 2);
+    }
+    lua_pop(L, 1);  /* file name */
+  }
+  lua_pop(L, 3);  /* nil, files, and root */
+  return n;
+}
+
+
+static int ll_buildindex (lua_State *L) {
+  const char *path;
+  int depth = luaL_optint(L, 2, 0);
+  int n = 0;
+#if defined(LISTMSG)
+  return luaL_error(L, LISTMSG);
+#endif
+  luaL_argcheck(L, 0 <= depth && depth <= MAXINDEXDEPTH, 2, "out of range");
+  lua_settop(L, 1);
+  if (lua_isnil(L, 1)) {
+    lua_getfield(L, LUA_ENVIRONINDEX, "path");
+    lua_replace(L, 1);
+  }
+  path = luaL_checkstring(L, 1);
+  lua_newtable(L);  /* index */
+  lua_newtable(L);  /* listed roots */
+  while ((path = pushnexttemplate(L, path)) != NULL) {
+    n += indextemplate(L, lua_tostring(L, -1), 2, 3, depth);
+    lua_pop(L, 1);  /* template */
+  }
+  lua_pop(L, 1);
+  lua_setfield(L, LUA_ENVIRONINDEX, "index");
+  lua_pushinteger(L, n);
+  return 1;
+}
+
+
+static int ll_indexstats (lua_State *L) {
+  IndexStats *s = getindexstats(L);
+  lua_pushnumber(L, (lua_Number)s->lookups);
+  lua_pushnumber(L, (lua_Number)s->misses);
+  return 2;
+}
+
+
+/*
+** resolves `name' through the index at the top without probing files;
+** returns 0, leaving the index at the top, when it is not there
+*/
+static int findindexed (lua_State *L, const char *name) {
+  IndexStats *s = getindexstats(L);
+  s->lookups++;
+  lua_getfield(L, -1, name);
+  if (lua_isfunction(L, -1))
+    return 1;  /* index holds the loader itself */
+  else if (lua_isstring(L, -1)) {
+    const char *filename = lua_tostring(L, -1);
+    if (luaL_loadfile(L, filename) != 0)
+      loaderror(L, filename);
+    return 1;  /* library loaded successfully */
+  }
+  s->misses++;
+  lua_pop(L, 1);
+  return 0;
+}
+
+
 static int loader_Lua (lua_State *L) {
   const char *filename;
   const char *name = luaL_checkstring(L, 1);
+  lua_getfield(L, LUA_ENVIRONINDEX, "index");
+  if (lua_istable(L, -1) && findindexed(L, name))  /* index knows it? */
+    return 1;
+  lua_pop(L, 1);  /* index; search the path for modules it misses */
   filename = findfile(L, name, "path");
   if (filename == NULL) return 1;  /* library not found in this path */
   if (luaL_loadfile(L, filename) != 0)
@@ -613,6 +848,13 @@ static const luaL_Reg pk_funcs[] = {
 };
 
 
+static const luaL_Reg ix_funcs[] = {
+  {"buildindex", ll_buildindex},
+  {"indexstats", ll_indexstats},
+  {NULL, NULL}
+};
+
+
 static const luaL_Reg ll_funcs[] = {
   {"module", ll_module},
   {"require", ll_require},
@@ -626,10 +868,15 @@ static const lua_CFunction loaders[] =
 
 LUALIB_API int luaopen_package (lua_State *L) {
   int i;
+  IndexStats *s;
   /* create new type _LOADLIB */
   luaL_newmetatable(L, "_LOADLIB");
   lua_pushcfunction(L, gctm);
   lua_setfield(L, -2, "__gc");
+  /* create counters for the module index */
+  s = (IndexStats *)lua_newuserdata(L, sizeof(IndexStats));
+  s->lookups = s->misses = 0;
+  lua_setfield(L, LUA_REGISTRYINDEX, "_INDEXSTATS");
   /* create `package' table */
   luaL_register(L, LUA_LOADLIBNAME, pk_funcs);
 #if defined(LUA_COMPAT_LOADLIB) 
@@ -638,6 +885,7 @@ LUALIB_API int luaopen_package (lua_State *L) {
 #endif
   lua_pushvalue(L, -1);
   lua_replace(L, LUA_ENVIRONINDEX);
+  luaL_register(L, NULL, ix_funcs);  /* these use `package' as environment */
   /* create `loaders' table */
   lua_createtable(L, 0, sizeof(loaders)/sizeof(loaders[0]) - 1);
   /* fill it with pre-defined loaders */
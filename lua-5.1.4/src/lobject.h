@@ -249,6 +249,7 @@ typedef struct Proto {
   struct LocVar *locvars;  /* information about local variables */
   TString **upvalues;  /* upvalue names */
   TString  *source;
+  TString  *debugfile;  /* side file with the debug information, until loaded */
   int sizeupvalues;
   int sizek;  /* size of `k' */
   int sizecode;
@@ -257,6 +258,8 @@ typedef struct Proto {
   int sizelocvars;
   int linedefined;
   int lastlinedefined;
+  int debugoffset;  /* position of the debug information in `debugfile' */
+  int debugsize;
   GCObject *gclist;
   lu_byte nups;  /* number of upvalues */
   lu_byte numparams;
@@ -229,6 +229,8 @@ static int singlevaraux (FuncState *fs, TString *n, expdesc *var, int base) {
   else {
     int v = searchvar(fs, n);  /* look up at current level */
     if (v >= 0) {
+      if (v == fs->f->numparams && (fs->f->is_vararg & VARARG_NEEDSARG))
+        fs->usesarg = 1;  /* it is the `arg' parameter */
       init_exp(var, VLOCAL, v);
       if (!base)
         markupval(fs, v);  /* local will be used as an upval */
@@ -341,6 +343,7 @@ static void open_func (LexState *ls, FuncState *fs) {
   fs->np = 0;
   fs->nlocvars = 0;
   fs->nactvar = 0;
+  fs->usesarg = 0;
   fs->bl = NULL;
   f->source = ls->source;
   f->maxstacksize = 2;  /* registers 0/1 are always valid */
@@ -586,6 +589,8 @@ static void body (LexState *ls, expdesc *e, int needself, int line) {
   parlist(ls);
   checknext(ls, ')');
   chunk(ls);
+  if (!new_fs.usesarg)  /* no need to build an `arg' table on each call */
+    new_fs.f->is_vararg &= ~VARARG_NEEDSARG;
   new_fs.f->lastlinedefined = ls->linenumber;
   check_match(ls, TK_END, TK_FUNCTION, line);
   close_func(ls);
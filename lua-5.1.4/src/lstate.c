@@ -6,6 +6,7 @@
 
 
 #include <stddef.h>
+#include <string.h>
 
 #define lstate_c
 #define LUA_CORE
@@ -39,15 +40,17 @@ typedef struct LG {
   
 
 
-static void stack_init (lua_State *L1, lua_State *L) {
-  /* initialize CallInfo array */
-  L1->base_ci = luaM_newvector(L, BASIC_CI_SIZE, CallInfo);
+/*
+** largest stack and CallInfo array kept in the thread pool; threads
+** that grew beyond these are freed instead of recycled
+*/
+#define MAXPOOLSTACK	(8*BASIC_STACK_SIZE + EXTRA_STACK)
+#define MAXPOOLCI	(8*BASIC_CI_SIZE)
+
+
+static void stack_reset (lua_State *L1) {
   L1->ci = L1->base_ci;
-  L1->size_ci = BASIC_CI_SIZE;
   L1->end_ci = L1->base_ci + L1->size_ci - 1;
-  /* initialize stack array */
-  L1->stack = luaM_newvector(L, BASIC_STACK_SIZE + EXTRA_STACK, TValue);
-  L1->stacksize = BASIC_STACK_SIZE + EXTRA_STACK;
   L1->top = L1->stack;
   L1->stack_last = L1->stack+(L1->stacksize - EXTRA_STACK)-1;
   /* initialize first ci */
@@ -58,9 +61,22 @@ static void stack_init (lua_State *L1, lua_State *L) {
 }
 
 
+static void stack_init (lua_State *L1, lua_State *L) {
+  /* initialize CallInfo array */
+  L1->base_ci = luaM_newvector(L, BASIC_CI_SIZE, CallInfo);
+  L1->size_ci = BASIC_CI_SIZE;
+  /* initialize stack array */
+  L1->stack = cast(TValue *, luaM_malloc(L,
+                  (BASIC_STACK_SIZE + EXTRA_STACK) * STACKSLOT_SIZE));
+  L1->stacksize = BASIC_STACK_SIZE + EXTRA_STACK;
+  memset(upvalmap(L1), 0, L1->stacksize * sizeof(UpVal *));
+  stack_reset(L1);
+}
+
+
 static void freestack (lua_State *L, lua_State *L1) {
   luaM_freearray(L, L1->base_ci, L1->size_ci, CallInfo);
-  luaM_freearray(L, L1->stack, L1->stacksize, TValue);
+  luaM_freemem(L, L1->stack, L1->stacksize * STACKSLOT_SIZE);
 }
 
 
@@ -106,6 +122,13 @@ static void close_state (lua_State *L) {
   global_State *g = G(L);
   luaF_close(L, L->stack);  /* close all upvalues for this thread */
   luaC_freeall(L);  /* collect all objects */  // ͷGCObjectSFIXEDBITmainthread
+  // ̳߳ﻺ߳ѲGCϣfreeallͷŲͷǺǵջ
+  while (g->threadpool != NULL) {  /* free recycled threads */
+    lua_State *L1 = gco2th(g->threadpool);
+    g->threadpool = L1->next;
+    freestack(L, L1);
+    luaM_freemem(L, fromstate(L1), state_size(lua_State));
+  }
   lua_assert(g->rootgc == obj2gco(L));
   lua_assert(g->strt.nuse == 0);
   luaM_freearray(L, G(L)->strt.hash, G(L)->strt.size, TString *);
@@ -117,11 +140,38 @@ static void close_state (lua_State *L) {
 }
 
 
-lua_State *luaE_newthread (lua_State *L) {
-  lua_State *L1 = tostate(luaM_malloc(L, state_size(lua_State)));
+static lua_State *reusethread (lua_State *L) {
+  global_State *g = G(L);
+  lua_State *L1 = gco2th(g->threadpool);
+  TValue *stack = L1->stack;
+  CallInfo *base_ci = L1->base_ci;
+  int stacksize = L1->stacksize;
+  int size_ci = L1->size_ci;
+  g->threadpool = L1->next;
+  g->nthreadpool--;
+  g->nthreadreuse++;
   luaC_link(L, obj2gco(L1), LUA_TTHREAD);
-  preinit_state(L1, G(L));
-  stack_init(L1, L);  /* init stack */
+  preinit_state(L1, g);
+  L1->stack = stack;  /* keep the old stack and CallInfo array */
+  L1->stacksize = stacksize;
+  L1->stack_last = L1->stack + (L1->stacksize - EXTRA_STACK) - 1;
+  L1->base_ci = base_ci;
+  L1->size_ci = size_ci;
+  stack_reset(L1);
+  return L1;
+}
+
+
+lua_State *luaE_newthread (lua_State *L) {
+  lua_State *L1;
+  if (G(L)->threadpool != NULL)
+    L1 = reusethread(L);
+  else {
+    L1 = tostate(luaM_malloc(L, state_size(lua_State)));
+    luaC_link(L, obj2gco(L1), LUA_TTHREAD);
+    preinit_state(L1, G(L));
+    stack_init(L1, L);  /* init stack */
+  }
   setobj2n(L, gt(L1), gt(L));  /* share table of globals */
   L1->hookmask = L->hookmask;
   L1->basehookcount = L->basehookcount;
@@ -133,9 +183,17 @@ lua_State *luaE_newthread (lua_State *L) {
 
 
 void luaE_freethread (lua_State *L, lua_State *L1) {
+  global_State *g = G(L);
   luaF_close(L1, L1->stack);  /* close all upvalues for this thread */
   lua_assert(L1->openupval == NULL);
   luai_userstatefree(L1);
+  if (g->nthreadpool < LUAI_MAXTHREADPOOL &&
+      L1->stacksize <= MAXPOOLSTACK && L1->size_ci <= MAXPOOLCI) {
+    L1->next = g->threadpool;  /* keep it for the next new thread */
+    g->threadpool = obj2gco(L1);
+    g->nthreadpool++;
+    return;
+  }
   freestack(L, L1);
   luaM_freemem(L, fromstate(L1), state_size(lua_State));
 }
@@ -179,6 +237,11 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   g->gcpause = LUAI_GCPAUSE;
   g->gcstepmul = LUAI_GCMUL;
   g->gcdept = 0;
+  g->threadpool = NULL;
+  g->nthreadpool = 0;
+  g->nstackrealloc = g->ncirealloc = g->nthreadreuse = 0;
+  g->debugloader = NULL;
+  g->debugud = NULL;
   for (i=0; i<NUM_TAGS; i++) g->mt[i] = NULL;
   if (luaD_rawrunprotected(L, f_luaopen, NULL) != 0) {
     /* memory allocation error: free partial state */
@@ -33,6 +33,13 @@ struct lua_longjmp;  /* defined in ldo.c */
 
 #define BASIC_STACK_SIZE        (2*LUA_MINSTACK)
 
+/*
+** the stack block holds `stacksize' TValues followed by `stacksize'
+** UpVal pointers: the open upvalue of each stack slot, or NULL
+*/
+#define STACKSLOT_SIZE	(sizeof(TValue) + sizeof(UpVal *))
+#define upvalmap(L)	(cast(UpVal **, (L)->stack + (L)->stacksize))
+
 
 // 字符串表
 // 由于全局只有一个，不用太考虑空间利用率
@@ -97,6 +104,13 @@ typedef struct global_State {
   TString *tmname[TM_N];  /* array with tag-method names */  // 以TString指针的方式记录所有元方法的名字  
 															 // lua的gc算法并不做内存整理，它不会在内存迁移数据，所以如果一个string肯定不会被清除
 															 // 那么它的内存地址也是不变的
+  GCObject *threadpool;  /* dead threads kept for reuse (linked by `next') */
+  int nthreadpool;  /* number of threads in `threadpool' */
+  lu_mem nstackrealloc;  /* number of stack reallocations */
+  lu_mem ncirealloc;  /* number of CallInfo array reallocations */
+  lu_mem nthreadreuse;  /* number of threads taken from `threadpool' */
+  lua_DebugLoader debugloader;  /* reads debug information from side files */
+  void *debugud;  /* auxiliary data to `debugloader' */
 } global_State;
 
 
@@ -6,6 +6,7 @@
 
 
 #include <ctype.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -463,6 +464,33 @@ static const char *lmemfind (const char *s1, size_t l1,
 }
 
 
+/*
+** check whether pattern `p' (of length `lp') can only match its own
+** text, so that it can be searched with `lmemfind'. A stray `)' is not
+** literal: it must still raise an "invalid pattern capture" error.
+*/
+static int isliteral (const char *p, size_t lp) {
+  return (lp > 0 && strlen(p) == lp && strpbrk(p, SPECIALS ")") == NULL);
+}
+
+
+/*
+** if every match of pattern `p' must start with a fixed character,
+** return it, so that scans can skip with `memchr' the positions where
+** the pattern cannot start; otherwise return -1
+*/
+static int firstliteral (const char *p) {
+  if (*p == '\0' || strchr(SPECIALS ")", *p) != NULL)
+    return -1;
+  switch (*(p+1)) {
+    case '*': case '?': case '-':  /* first item may be skipped */
+      return -1;
+    default:
+      return uchar(*p);
+  }
+}
+
+
 static void push_onecapture (MatchState *ms, int i, const char *s,
                                                     const char *e) {
   if (i >= ms->level) {
@@ -509,15 +537,27 @@ static int str_find_aux (lua_State *L, int find) {
       return 2;
     }
   }
+  else if (!find && isliteral(p, l2)) {
+    /* a match of a literal pattern is the pattern itself */
+    if (lmemfind(s+init, l1-init, p, l2)) {
+      lua_pushvalue(L, 2);
+      return 1;
+    }
+  }
   else {
     MatchState ms;
     int anchor = (*p == '^') ? (p++, 1) : 0;
+    int fc = anchor ? -1 : firstliteral(p);
     const char *s1=s+init;
     ms.L = L;
     ms.src_init = s;
     ms.src_end = s+l1;
     do {
       const char *res;
+      if (fc >= 0) {  /* skip positions where the pattern cannot start */
+        s1 = (const char *)memchr(s1, fc, ms.src_end - s1);
+        if (s1 == NULL) break;
+      }
       ms.level = 0;
       if ((res=match(&ms, s1, p)) != NULL) {
         if (find) {
@@ -547,17 +587,29 @@ static int str_match (lua_State *L) {
 
 static int gmatch_aux (lua_State *L) {
   MatchState ms;
-  size_t ls;
+  size_t ls, lp;
   const char *s = lua_tolstring(L, lua_upvalueindex(1), &ls);
-  const char *p = lua_tostring(L, lua_upvalueindex(2));
-  const char *src;
+  const char *p = lua_tolstring(L, lua_upvalueindex(2), &lp);
+  const char *src = s + (size_t)lua_tointeger(L, lua_upvalueindex(3));
+  int fc;
+  if (isliteral(p, lp)) {
+    const char *e = lmemfind(src, (s + ls) - src, p, lp);
+    if (e == NULL) return 0;  /* not found */
+    lua_pushinteger(L, e + lp - s);
+    lua_replace(L, lua_upvalueindex(3));
+    lua_pushvalue(L, lua_upvalueindex(2));  /* match is the pattern itself */
+    return 1;
+  }
+  fc = firstliteral(p);
   ms.L = L;
   ms.src_init = s;
   ms.src_end = s+ls;
-  for (src = s + (size_t)lua_tointeger(L, lua_upvalueindex(3));
-       src <= ms.src_end;
-       src++) {
+  for (; src <= ms.src_end; src++) {
     const char *e;
+    if (fc >= 0) {  /* skip positions where the pattern cannot start */
+      src = (const char *)memchr(src, fc, ms.src_end - src);
+      if (src == NULL) break;
+    }
     ms.level = 0;
     if ((e = match(&ms, src, p)) != NULL) {
       lua_Integer newstart = e-s;
@@ -643,11 +695,14 @@ static void add_value (MatchState *ms, luaL_Buffer *b, const char *s,
 
 static int str_gsub (lua_State *L) {
   size_t srcl;
+  size_t lp;
   const char *src = luaL_checklstring(L, 1, &srcl);
-  const char *p = luaL_checkstring(L, 2);
+  const char *p = luaL_checklstring(L, 2, &lp);
   int  tr = lua_type(L, 3);
   int max_s = luaL_optint(L, 4, srcl+1);
-  int anchor = (*p == '^') ? (p++, 1) : 0;
+  int anchor = (*p == '^') ? (p++, lp--, 1) : 0;
+  int literal = !anchor && isliteral(p, lp);
+  int fc = anchor ? -1 : firstliteral(p);
   int n = 0;
   MatchState ms;
   luaL_Buffer b;
@@ -660,8 +715,16 @@ static int str_gsub (lua_State *L) {
   ms.src_end = src+srcl;
   while (n < max_s) {
     const char *e;
+    if (fc >= 0) {  /* copy at once the text where no match can start */
+      const char *next = literal ?
+                         lmemfind(src, ms.src_end - src, p, lp) :
+                         (const char *)memchr(src, fc, ms.src_end - src);
+      if (next == NULL) break;
+      luaL_addlstring(&b, src, next - src);
+      src = next;
+    }
     ms.level = 0;
-    e = match(&ms, src, p);
+    e = literal ? src + lp : match(&ms, src, p);
     if (e) {
       n++;
       add_value(&ms, &b, src, e);
@@ -753,18 +816,16 @@ static void addintlen (char *form) {
 }
 
 
-static int str_format (lua_State *L) {
-  int arg = 1;
+/* format the arguments after the format string at `arg' into `b' */
+static void aux_format (lua_State *L, int arg, luaL_Buffer *b) {
   size_t sfl;
   const char *strfrmt = luaL_checklstring(L, arg, &sfl);
   const char *strfrmt_end = strfrmt+sfl;
-  luaL_Buffer b;
-  luaL_buffinit(L, &b);
   while (strfrmt < strfrmt_end) {
     if (*strfrmt != L_ESC)
-      luaL_addchar(&b, *strfrmt++);
+      luaL_addchar(b, *strfrmt++);
     else if (*++strfrmt == L_ESC)
-      luaL_addchar(&b, *strfrmt++);  /* %% */
+      luaL_addchar(b, *strfrmt++);  /* %% */
     else { /* format item */
       char form[MAX_FORMAT];  /* to store the format (`%...') */
       char buff[MAX_ITEM];  /* to store the formatted item */
@@ -791,7 +852,7 @@ static int str_format (lua_State *L) {
           break;
         }
         case 'q': {
-          addquoted(L, &b, arg);
+          addquoted(L, b, arg);
           continue;  /* skip the 'addsize' at the end */
         }
         case 's': {
@@ -801,7 +862,7 @@ static int str_format (lua_State *L) {
             /* no precision and string is too long to be formatted;
                keep original string */
             lua_pushvalue(L, arg);
-            luaL_addvalue(&b);
+            luaL_addvalue(b);
             continue;  /* skip the `addsize' at the end */
           }
           else {
@@ -810,19 +871,199 @@ static int str_format (lua_State *L) {
           }
         }
         default: {  /* also treat cases `pnLlh' */
-          return luaL_error(L, "invalid option " LUA_QL("%%%c") " to "
-                               LUA_QL("format"), *(strfrmt - 1));
+          luaL_error(L, "invalid option " LUA_QL("%%%c") " to "
+                        LUA_QL("format"), *(strfrmt - 1));
         }
       }
-      luaL_addlstring(&b, buff, strlen(buff));
+      luaL_addlstring(b, buff, strlen(buff));
     }
   }
+}
+
+
+static int str_format (lua_State *L) {
+  luaL_Buffer b;
+  luaL_buffinit(L, &b);
+  aux_format(L, 1, &b);
   luaL_pushresult(&b);
   return 1;
 }
 
 
+/*
+** {======================================================
+** STRING BUILDER
+** A growable byte buffer for generating large outputs piece by piece:
+** appended pieces are copied into it without creating Lua strings,
+** and only the final `tostring' interns the result.
+** =======================================================
+*/
+
+
+#define LUA_STRBUILDER	"StringBuilder"
+
+#define MAX_SIZE	(~(size_t)0)
+
+
+typedef struct StrBuilder {
+  char *p;  /* contents (not `\0' terminated) */
+  size_t n;  /* number of bytes in use */
+  size_t size;  /* allocated size of `p' */
+} StrBuilder;
+
+
+#define tobuilder(L)	((StrBuilder *)luaL_checkudata(L, 1, LUA_STRBUILDER))
+
+
+/* make room for `l' more bytes; return where they go */
+static char *sb_reserve (lua_State *L, StrBuilder *sb, size_t l) {
+  if (sb->size - sb->n < l) {
+    void *ud;
+    lua_Alloc allocf = lua_getallocf(L, &ud);
+    size_t newsize = (sb->size > 0) ? sb->size : LUAL_BUFFERSIZE;
+    char *np;
+    if (l > MAX_SIZE - sb->n)
+      luaL_error(L, "string builder size overflow");
+    while (newsize - sb->n < l) {  /* grow geometrically */
+      if (newsize > MAX_SIZE/2) {
+        newsize = sb->n + l;
+        break;
+      }
+      newsize *= 2;
+    }
+    np = (char *)(*allocf)(ud, sb->p, sb->size, newsize);
+    if (np == NULL)
+      luaL_error(L, "not enough memory");
+    sb->p = np;
+    sb->size = newsize;
+  }
+  return sb->p + sb->n;
+}
+
+
+static void sb_addlstring (lua_State *L, StrBuilder *sb, const char *s,
+                                                         size_t l) {
+  memcpy(sb_reserve(L, sb, l), s, l);
+  sb->n += l;
+}
+
+
+static int str_builder (lua_State *L) {
+  lua_Integer n = luaL_optinteger(L, 1, 0);
+  size_t size;
+  StrBuilder *sb;
+  luaL_argcheck(L, 0 <= n && n <= INT_MAX, 1, "size out of range");
+  size = (size_t)n;
+  sb = (StrBuilder *)lua_newuserdata(L, sizeof(StrBuilder));
+  sb->p = NULL;
+  sb->n = sb->size = 0;
+  luaL_getmetatable(L, LUA_STRBUILDER);
+  lua_setmetatable(L, -2);
+  if (size > 0)
+    sb_reserve(L, sb, size);
+  return 1;
+}
+
+
+static int sb_append (lua_State *L) {
+  StrBuilder *sb = tobuilder(L);
+  int n = lua_gettop(L);
+  int i;
+  for (i = 2; i <= n; i++) {
+    if (lua_type(L, i) == LUA_TNUMBER) {  /* format it in place */
+      char buff[LUAI_MAXNUMBER2STR];
+      lua_number2str(buff, lua_tonumber(L, i));
+      sb_addlstring(L, sb, buff, strlen(buff));
+    }
+    else {
+      size_t l;
+      const char *s = luaL_checklstring(L, i, &l);
+      sb_addlstring(L, sb, s, l);
+    }
+  }
+  lua_settop(L, 1);
+  return 1;  /* return the builder, for chaining */
+}
+
+
+static int sb_appendf (lua_State *L) {
+  StrBuilder *sb = tobuilder(L);
+  luaL_Buffer b;
+  luaL_buffinit(L, &b);
+  aux_format(L, 2, &b);
+  if (b.lvl == 0)  /* result still in the C buffer? copy it from there */
+    sb_addlstring(L, sb, b.buffer, b.p - b.buffer);
+  else {
+    size_t l;
+    const char *s;
+    luaL_pushresult(&b);
+    s = lua_tolstring(L, -1, &l);
+    sb_addlstring(L, sb, s, l);
+  }
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+static int sb_reset (lua_State *L) {
+  tobuilder(L)->n = 0;  /* keep the memory for reuse */
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+static int sb_tostring (lua_State *L) {
+  StrBuilder *sb = tobuilder(L);
+  lua_pushlstring(L, sb->p, sb->n);
+  return 1;
+}
+
+
+static int sb_len (lua_State *L) {
+  lua_pushinteger(L, tobuilder(L)->n);
+  return 1;
+}
+
+
+static int sb_gc (lua_State *L) {
+  StrBuilder *sb = tobuilder(L);
+  if (sb->p != NULL) {
+    void *ud;
+    lua_Alloc allocf = lua_getallocf(L, &ud);
+    (*allocf)(ud, sb->p, sb->size, 0);
+    sb->p = NULL;
+    sb->n = sb->size = 0;
+  }
+  return 0;
+}
+
+
+static const luaL_Reg sblib[] = {
+  {"append", sb_append},
+  {"appendf", sb_appendf},
+  {"len", sb_len},
+  {"reset", sb_reset},
+  {"tostring", sb_tostring},
+  {"__gc", sb_gc},
+  {"__len", sb_len},
+  {"__tostring", sb_tostring},
+  {NULL, NULL}
+};
+
+
+static void createbuildermeta (lua_State *L) {
+  luaL_newmetatable(L, LUA_STRBUILDER);
+  lua_pushvalue(L, -1);  /* push metatable */
+  lua_setfield(L, -2, "__index");  /* metatable.__index = metatable */
+  luaL_register(L, NULL, sblib);
+  lua_pop(L, 1);
+}
+
+/* }====================================================== */
+
+
 static const luaL_Reg strlib[] = {
+  {"builder", str_builder},
   {"byte", str_byte},
   {"char", str_char},
   {"dump", str_dump},
@@ -864,6 +1105,7 @@ LUALIB_API int luaopen_string (lua_State *L) {
   lua_setfield(L, -2, "gfind");
 #endif
   createmetatable(L);
+  createbuildermeta(L);
   return 1;
 }
 
@@ -6,6 +6,7 @@
 
 
 #include <stddef.h>
+#include <string.h>
 
 #define ltablib_c
 #define LUA_LIB
@@ -141,14 +142,70 @@ static void addfield (lua_State *L, luaL_Buffer *b, int i) {
 }
 
 
+/* length of the string for t[i], checking it as `addfield' does */
+static size_t fieldlen (lua_State *L, int i) {
+  size_t l;
+  lua_rawgeti(L, 1, i);
+  if (!lua_isstring(L, -1))
+    luaL_error(L, "invalid value (%s) at index %d in table for "
+                  LUA_QL("concat"), luaL_typename(L, -1), i);
+  lua_tolstring(L, -1, &l);
+  lua_pop(L, 1);
+  return l;
+}
+
+
+/* copies t[i] to `p' inside the `total' bytes at `res', returns the new end */
+static char *copyfield (lua_State *L, int i, char *res, size_t total, char *p) {
+  size_t l;
+  const char *s;
+  lua_rawgeti(L, 1, i);
+  s = lua_tolstring(L, -1, &l);
+  if (s == NULL || l > total - (size_t)(p - res))
+    luaL_error(L, "table changed during " LUA_QL("concat"));
+  memcpy(p, s, l);
+  lua_pop(L, 1);
+  return p + l;
+}
+
+
+static size_t addlen (lua_State *L, size_t total, size_t l) {
+  if (l > ~(size_t)0 - total)
+    luaL_error(L, "resulting string too large");
+  return total + l;
+}
+
+
 static int tconcat (lua_State *L) {
   luaL_Buffer b;
   size_t lsep;
+  size_t total = 0;
   int i, last;
   const char *sep = luaL_optlstring(L, 2, "", &lsep);
   luaL_checktype(L, 1, LUA_TTABLE);
   i = luaL_optint(L, 3, 1);
   last = luaL_opt(L, luaL_checkint, 4, luaL_getn(L, 1));
+  if (i <= last) {  /* compute the size of the result */
+    int k;
+    for (k = i; k < last; k++)  /* `k <= last' would overflow at INT_MAX */
+      total = addlen(L, addlen(L, total, fieldlen(L, k)), lsep);
+    total = addlen(L, total, fieldlen(L, last));
+  }
+  if (total > LUAL_BUFFERSIZE) {
+    /* build the result in one block instead of concatenating pieces */
+    char *res = (char *)lua_newuserdata(L, total);
+    char *p = res;
+    for (; i < last; i++) {
+      p = copyfield(L, i, res, total, p);
+      if (lsep > total - (size_t)(p - res))
+        luaL_error(L, "table changed during " LUA_QL("concat"));
+      memcpy(p, sep, lsep);
+      p += lsep;
+    }
+    p = copyfield(L, last, res, total, p);
+    lua_pushlstring(L, res, (size_t)(p - res));
+    return 1;
+  }
   luaL_buffinit(L, &b);
   for (; i < last; i++) {
     addfield(L, &b, i);
@@ -190,9 +247,63 @@ static int sort_comp (lua_State *L, int a, int b) {
     return lua_lessthan(L, a, b);
 }
 
-static void auxsort (lua_State *L, int l, int u) {
+/* sift a[l+i] down the heap a[l..l+n-1] (children of i are 2i+1, 2i+2) */
+static void siftdown (lua_State *L, int l, int i, int n) {
+  for (;;) {
+    int c = 2*i + 1;
+    if (c >= n) break;
+    if (c + 1 < n) {
+      lua_rawgeti(L, 1, l+c);
+      lua_rawgeti(L, 1, l+c+1);
+      if (sort_comp(L, -2, -1))  /* a[c]<a[c+1]? */
+        c++;
+      lua_pop(L, 2);
+    }
+    lua_rawgeti(L, 1, l+i);
+    lua_rawgeti(L, 1, l+c);
+    if (!sort_comp(L, -2, -1)) {  /* a[i]>=a[c]? */
+      lua_pop(L, 2);
+      break;
+    }
+    set2(L, l+i, l+c);
+    i = c;
+  }
+}
+
+/*
+** heapsort of a[l..u], used when quicksort keeps splitting badly; it
+** never indexes outside a[l..u], even with an invalid order function
+*/
+static void auxheapsort (lua_State *L, int l, int u) {
+  int n = u-l+1;
+  int i;
+  for (i = n/2 - 1; i >= 0; i--)
+    siftdown(L, l, i, n);
+  for (i = n-1; i > 0; i--) {
+    lua_rawgeti(L, 1, l);
+    lua_rawgeti(L, 1, l+i);
+    set2(L, l, l+i);  /* move largest element to the end */
+    siftdown(L, l, 0, i);
+  }
+}
+
+/* depth allowed to quicksort before switching to heapsort: 2*log2(n) */
+static int sortdepth (int n) {
+  int d = 0;
+  while (n > 1) {
+    n >>= 1;
+    d += 2;
+  }
+  return d;
+}
+
+static void auxsort (lua_State *L, int l, int u, int depth) {
   while (l < u) {  /* for tail recursion */
     int i, j;
+    if (depth-- == 0) {  /* too many bad splits? */
+      auxheapsort(L, l, u);
+      return;
+    }
     /* sort elements a[l], a[(l+u)/2] and a[u] */
     lua_rawgeti(L, 1, l);
     lua_rawgeti(L, 1, u);
@@ -249,21 +360,295 @@ static void auxsort (lua_State *L, int l, int u) {
     else {
       j=i+1; i=u; u=j-2;
     }
-    auxsort(L, j, i);  /* call recursively the smaller one */
+    auxsort(L, j, i, depth);  /* call recursively the smaller one */
   }  /* repeat the routine for the larger one */
 }
 
-static int sort (lua_State *L) {
-  int n = aux_getn(L, 1);
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Sorting of numbers or strings without an order function: their
+** keys are copied into a C array and sorted there, with no API call
+** per comparison, and the table is then permuted to the new order.
+** =======================================================
+*/
+
+
+/* below this size, key arrays are sorted by insertion */
+#define SORT_SMALL	12
+
+typedef struct SortKey {
+  union {
+    lua_Number n;
+    struct {
+      const char *s;
+      size_t l;
+    } s;
+  } u;
+  int pos;  /* position of the value in the table before sorting */
+} SortKey;
+
+typedef int (*KeyLess) (const SortKey *a, const SortKey *b);
+
+
+static int numless (const SortKey *a, const SortKey *b) {
+  return a->u.n < b->u.n;
+}
+
+
+/* same order as `l_strcmp' (lvm.c) uses for `<' */
+static int strless (const SortKey *a, const SortKey *b) {
+  const char *l = a->u.s.s;
+  size_t ll = a->u.s.l;
+  const char *r = b->u.s.s;
+  size_t lr = b->u.s.l;
+  for (;;) {
+    int temp = strcoll(l, r);
+    if (temp != 0) return temp < 0;
+    else {  /* strings are equal up to a `\0' */
+      size_t len = strlen(l);  /* index of first `\0' in both strings */
+      if (len == lr)  /* r is finished? */
+        return 0;
+      else if (len == ll)  /* l is finished? */
+        return 1;
+      len++;
+      l += len; ll -= len; r += len; lr -= len;
+    }
+  }
+}
+
+
+static void keyswap (SortKey *a, SortKey *b) {
+  SortKey t = *a;
+  *a = *b;
+  *b = t;
+}
+
+
+static void keysift (SortKey *a, int k, int n, KeyLess lt) {
+  for (;;) {
+    int c = 2*k + 1;
+    if (c >= n) break;
+    if (c + 1 < n && lt(&a[c], &a[c+1])) c++;
+    if (!lt(&a[k], &a[c])) break;
+    keyswap(&a[k], &a[c]);
+    k = c;
+  }
+}
+
+
+static void keyheapsort (SortKey *a, int n, KeyLess lt) {
+  int i;
+  for (i = n/2 - 1; i >= 0; i--)
+    keysift(a, i, n, lt);
+  for (i = n-1; i > 0; i--) {
+    keyswap(&a[0], &a[i]);  /* move largest key to the end */
+    keysift(a, 0, i, lt);
+  }
+}
+
+
+static void keysort (SortKey *a, int n, int depth, KeyLess lt) {
+  int i, j;
+  while (n > SORT_SMALL) {
+    SortKey p;
+    int m = n/2;
+    if (depth-- == 0) {  /* too many bad splits? */
+      keyheapsort(a, n, lt);
+      return;
+    }
+    /* sort a[0], a[m] and a[n-1]; they bound the partition loops */
+    if (lt(&a[m], &a[0])) keyswap(&a[m], &a[0]);
+    if (lt(&a[n-1], &a[m])) {
+      keyswap(&a[n-1], &a[m]);
+      if (lt(&a[m], &a[0])) keyswap(&a[m], &a[0]);
+    }
+    p = a[m];
+    i = 0; j = n-1;
+    for (;;) {  /* invariant: a[0..i] <= P <= a[j..n-1] */
+      while (lt(&a[++i], &p)) ;
+      while (lt(&p, &a[--j])) ;
+      if (i >= j) break;
+      keyswap(&a[i], &a[j]);
+    }
+    /* a[0..j] <= P <= a[j+1..n-1]; recurse into the smaller part */
+    if (j+1 < n-j-1) {
+      keysort(a, j+1, depth, lt);
+      a += j+1; n -= j+1;
+    }
+    else {
+      keysort(a+j+1, n-j-1, depth, lt);
+      n = j+1;
+    }
+  }
+  for (i = 1; i < n; i++) {  /* insertion sort */
+    SortKey k = a[i];
+    for (j = i; j > 0 && lt(&k, &a[j-1]); j--)
+      a[j] = a[j-1];
+    a[j] = k;
+  }
+}
+
+
+/*
+** rearrange t[1..n] so that t[i] gets the old t[perm[i-1]]: follows
+** each cycle of the permutation keeping one value on the stack, so
+** that every value stays referenced while it moves
+*/
+static void applyperm (lua_State *L, int *perm, int n) {
+  int i;
+  for (i = 0; i < n; i++) {
+    int j = i;
+    if (perm[i] == 0 || perm[i] == i+1) continue;  /* done or in place */
+    lua_rawgeti(L, 1, i+1);  /* goes to the end of the cycle */
+    for (;;) {
+      int k = perm[j];
+      perm[j] = 0;  /* mark it done */
+      if (k == i+1) break;
+      lua_rawgeti(L, 1, k);
+      lua_rawseti(L, 1, j+1);
+      j = k-1;
+    }
+    lua_rawseti(L, 1, j+1);
+  }
+}
+
+
+/*
+** sort t[1..n] with the default order if all its values are numbers
+** (but not NaN, which has no order) or all are strings; return 0,
+** with the table untouched, otherwise
+*/
+static int sortkeys (lua_State *L, int n) {
+  SortKey *a;
+  int t, i;
+  lua_rawgeti(L, 1, 1);
+  t = lua_type(L, -1);
+  lua_pop(L, 1);
+  if (t != LUA_TNUMBER && t != LUA_TSTRING) return 0;
+  if ((size_t)n > ~(size_t)0 / sizeof(SortKey))
+    luaL_error(L, "table too big to sort");
+  a = (SortKey *)lua_newuserdata(L, n * sizeof(SortKey));
+  for (i = 0; i < n; i++) {
+    lua_rawgeti(L, 1, i+1);
+    if (lua_type(L, -1) != t) {
+      lua_pop(L, 2);  /* value and keys */
+      return 0;
+    }
+    if (t == LUA_TNUMBER) {
+      a[i].u.n = lua_tonumber(L, -1);
+      if (a[i].u.n != a[i].u.n) {  /* NaN? */
+        lua_pop(L, 2);
+        return 0;
+      }
+    }
+    else  /* string stays alive in the table while it is sorted */
+      a[i].u.s.s = lua_tolstring(L, -1, &a[i].u.s.l);
+    a[i].pos = i+1;
+    lua_pop(L, 1);
+  }
+  keysort(a, n, sortdepth(n), (t == LUA_TNUMBER) ? numless : strless);
+  if (t == LUA_TNUMBER) {
+    for (i = 0; i < n; i++) {
+      lua_pushnumber(L, a[i].u.n);
+      lua_rawseti(L, 1, i+1);
+    }
+  }
+  else {
+    int *perm = (int *)lua_newuserdata(L, n * sizeof(int));
+    for (i = 0; i < n; i++)
+      perm[i] = a[i].pos;
+    applyperm(L, perm, n);
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+  return 1;
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Stable sort: a bottom-up merge sort of the positions 1..n, which
+** keeps equal elements in their original order
+** =======================================================
+*/
+
+
+static int pos_comp (lua_State *L, int a, int b) {
+  int res;
+  lua_rawgeti(L, 1, a);
+  lua_rawgeti(L, 1, b);
+  res = sort_comp(L, -2, -1);
+  lua_pop(L, 2);
+  return res;
+}
+
+
+static void auxmergesort (lua_State *L, int n) {
+  int *src, *dst;
+  int w, i;
+  if ((size_t)n > ~(size_t)0 / (2 * sizeof(int)))
+    luaL_error(L, "table too big to sort");
+  src = (int *)lua_newuserdata(L, 2 * n * sizeof(int));
+  dst = src + n;
+  for (i = 0; i < n; i++)
+    src[i] = i+1;
+  for (w = 1; w < n; w *= 2) {
+    int *t;
+    for (i = 0; i < n; i += 2*w) {
+      int l = i, m = (i+w < n) ? i+w : n, u = (i+2*w < n) ? i+2*w : n;
+      int k = i, r = m;
+      if (m < u && !pos_comp(L, src[m], src[m-1])) {  /* already ordered? */
+        memcpy(dst + i, src + i, (u - i) * sizeof(int));
+        continue;
+      }
+      while (l < m && r < u) {
+        if (pos_comp(L, src[r], src[l]))  /* take right only if smaller */
+          dst[k++] = src[r++];
+        else
+          dst[k++] = src[l++];
+      }
+      while (l < m) dst[k++] = src[l++];
+      while (r < u) dst[k++] = src[r++];
+    }
+    t = src; src = dst; dst = t;
+  }
+  applyperm(L, src, n);
+  lua_pop(L, 1);
+}
+
+/* }====================================================== */
+
+
+static void checksort (lua_State *L) {
   luaL_checkstack(L, 40, "");  /* assume array is smaller than 2^40 */
   if (!lua_isnoneornil(L, 2))  /* is there a 2nd argument? */
     luaL_checktype(L, 2, LUA_TFUNCTION);
   lua_settop(L, 2);  /* make sure there is two arguments */
-  auxsort(L, 1, n);
+}
+
+
+static int sort (lua_State *L) {
+  int n = aux_getn(L, 1);
+  checksort(L);
+  if (n > 1 && !(lua_isnil(L, 2) && sortkeys(L, n)))
+    auxsort(L, 1, n, sortdepth(n));
   return 0;
 }
 
-/* }====================================================== */
+
+static int stablesort (lua_State *L) {
+  int n = aux_getn(L, 1);
+  checksort(L);
+  /* equal numbers or strings cannot be told apart: any order is stable */
+  if (n > 1 && !(lua_isnil(L, 2) && sortkeys(L, n)))
+    auxmergesort(L, n);
+  return 0;
+}
 
 
 static const luaL_Reg tab_funcs[] = {
@@ -276,6 +661,7 @@ static const luaL_Reg tab_funcs[] = {
   {"remove", tremove},
   {"setn", setn},
   {"sort", sort},
+  {"stablesort", stablesort},
   {NULL, NULL}
 };
 
@@ -227,6 +227,10 @@ LUA_API int  (lua_status) (lua_State *L);
 #define LUA_GCSTEP		5
 #define LUA_GCSETPAUSE		6
 #define LUA_GCSETSTEPMUL	7
+#define LUA_GCSTACKREALLOC	8
+#define LUA_GCCIREALLOC		9
+#define LUA_GCTHREADREUSE	10
+#define LUA_GCTHREADPOOL	11
 
 LUA_API int (lua_gc) (lua_State *L, int what, int data);
 
@@ -344,6 +348,13 @@ LUA_API int lua_gethookmask (lua_State *L);
 LUA_API int lua_gethookcount (lua_State *L);
 
 
+/* Function to read debug information that `luac -d' left in a side file */
+typedef int (*lua_DebugLoader) (void *ud, const char *name, size_t offset,
+                                size_t size, char *buff);
+
+LUA_API void lua_setdebugloader (lua_State *L, lua_DebugLoader f, void *ud);
+
+
 struct lua_Debug {
   int event;
   const char *name;	/* (n) */
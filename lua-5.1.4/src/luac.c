@@ -29,6 +29,7 @@
 static int listing=0;			/* list bytecodes? */
 static int dumping=1;			/* dump bytecodes? */
 static int stripping=0;			/* strip debug information? */
+static const char* debugfile=NULL;	/* side file for debug information */
 static char Output[]={ OUTPUT };	/* default output file name */
 static const char* output=Output;	/* actual output file name */
 static const char* progname=PROGNAME;	/* actual program name */
@@ -39,12 +40,14 @@ static void fatal(const char* message)
  exit(EXIT_FAILURE);
 }
 
-static void cannot(const char* what)
+static void cannotfile(const char* what, const char* name)
 {
- fprintf(stderr,"%s: cannot %s %s: %s\n",progname,what,output,strerror(errno));
+ fprintf(stderr,"%s: cannot %s %s: %s\n",progname,what,name,strerror(errno));
  exit(EXIT_FAILURE);
 }
 
+#define cannot(what)	cannotfile(what,output)
+
 static void usage(const char* message)
 {
  if (*message=='-')
@@ -55,6 +58,7 @@ static void usage(const char* message)
  "usage: %s [options] [filenames].\n"
  "Available options are:\n"
  "  -        process stdin\n"
+ "  -d name  write debug information to file " LUA_QL("name") "\n"
  "  -l       list\n"
  "  -o name  output to file " LUA_QL("name") " (default is \"%s\")\n"
  "  -p       parse only\n"
@@ -84,6 +88,11 @@ static int doargs(int argc, char* argv[])
   }
   else if (IS("-"))			/* end of options; use stdin */
    break;
+  else if (IS("-d"))			/* debug information file */
+  {
+   debugfile=argv[++i];
+   if (debugfile==NULL || *debugfile==0) usage(LUA_QL("-d") " needs argument");
+  }
   else if (IS("-l"))			/* list */
    ++listing;
   else if (IS("-o"))			/* output file */
@@ -173,12 +182,26 @@ static int pmain(lua_State* L)
  if (dumping)
  {
   FILE* D= (output==NULL) ? stdout : fopen(output,"wb");
+  FILE* DF=NULL;
   if (D==NULL) cannot("open");
+  if (debugfile!=NULL && !stripping)
+  {
+   DF=fopen(debugfile,"wb");
+   if (DF==NULL) cannotfile("open",debugfile);
+  }
   lua_lock(L);
-  luaU_dump(L,f,writer,D,stripping);
+  if (DF!=NULL)
+   luaU_dumpsplit(L,f,writer,D,writer,DF,debugfile);
+  else
+   luaU_dump(L,f,writer,D,stripping);
   lua_unlock(L);
   if (ferror(D)) cannot("write");
   if (fclose(D)) cannot("close");
+  if (DF!=NULL)
+  {
+   if (ferror(DF)) cannotfile("write",debugfile);
+   if (fclose(DF)) cannotfile("close",debugfile);
+  }
  }
  return 0;
 }
@@ -56,6 +56,7 @@
 #define LUA_USE_ISATTY
 #define LUA_USE_POPEN
 #define LUA_USE_ULONGJMP
+#define LUA_USE_GETLINE
 #endif
 
 
@@ -435,6 +436,14 @@
 #define LUAI_MAXCALLS	20000
 
 
+/*
+@@ LUAI_MAXTHREADPOOL is the maximum number of dead coroutines whose
+@* stacks are kept for reuse by new coroutines.
+** CHANGE it to 0 to free coroutine stacks as soon as they are collected.
+*/
+#define LUAI_MAXTHREADPOOL	128
+
+
 /*
 @@ LUAI_MAXCSTACK limits the number of Lua stack slots that a C function
 @* can use.
@@ -684,6 +693,23 @@ union luai_Cast { double l_d; long l_l; };
 
 #endif
 
+
+/*
+@@ lua_getline reads a whole line (newline included) from a file into a
+@* 'malloc'ed buffer, growing the buffer when the line does not fit.
+** CHANGE it if your system has another way to read a line in a single
+** pass; it must return the number of bytes read, or -1 at end of file.
+** Without it, Lua reads lines in LUAL_BUFFERSIZE pieces with 'fgets'.
+*/
+#if defined(liolib_c) || defined(luaall_c)
+
+#if defined(LUA_USE_GETLINE)
+#include <sys/types.h>
+#define lua_getline(L,b,sz,f)	((void)L, (long)getline(b,sz,f))
+#endif
+
+#endif
+
 /*
 @@ LUA_DL_* define which dynamic-library system Lua should use.
 ** CHANGE here if Lua has problems choosing the appropriate
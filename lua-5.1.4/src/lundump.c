@@ -14,8 +14,10 @@
 #include "ldebug.h"
 #include "ldo.h"
 #include "lfunc.h"
+#include "lgc.h"
 #include "lmem.h"
 #include "lobject.h"
+#include "lstate.h"
 #include "lstring.h"
 #include "lundump.h"
 #include "lzio.h"
@@ -137,7 +139,16 @@ static void LoadConstants(LoadState* S, Proto* f)
 static void LoadDebug(LoadState* S, Proto* f)
 {
  int i,n;
- n=LoadInt(S);
+ LoadVar(S,n);
+ if (n==LUAC_SPLITDEBUG)		/* kept in a side file? */
+ {
+  f->debugfile=LoadString(S);
+  f->debugoffset=LoadInt(S);
+  f->debugsize=LoadInt(S);
+  IF (f->debugfile==NULL, "bad debug file");
+  return;
+ }
+ IF (n<0, "bad integer");
  f->lineinfo=luaM_newvector(S->L,n,int);
  f->sizelineinfo=n;
  LoadVector(S,f->lineinfo,n,sizeof(int));
@@ -208,6 +219,90 @@ Proto* luaU_undump (lua_State* L, ZIO* Z, Mbuffer* buff, const char* name)
  return LoadFunction(&S,luaS_newliteral(L,"=?"));
 }
 
+typedef struct {
+ LoadState S;
+ Proto* f;
+} DebugLoad;
+
+typedef struct {
+ const char* s;
+ size_t size;
+} DebugBuffer;
+
+static const char* ReadDebug(lua_State* L, void* ud, size_t* size)
+{
+ DebugBuffer* b=(DebugBuffer*)ud;
+ UNUSED(L);
+ if (b->size==0) return NULL;
+ *size=b->size;
+ b->size=0;
+ return b->s;
+}
+
+static void f_loaddebug(lua_State* L, void* ud)
+{
+ DebugLoad* d=(DebugLoad*)ud;
+ UNUSED(L);
+ LoadDebug(&d->S,d->f);
+}
+
+static void FreeDebug(lua_State* L, Proto* f)
+{
+ luaM_freearray(L,f->lineinfo,f->sizelineinfo,int);
+ luaM_freearray(L,f->locvars,f->sizelocvars,LocVar);
+ luaM_freearray(L,f->upvalues,f->sizeupvalues,TString*);
+ f->lineinfo=NULL; f->sizelineinfo=0;
+ f->locvars=NULL; f->sizelocvars=0;
+ f->upvalues=NULL; f->sizeupvalues=0;
+}
+
+/*
+* load debug information from the side file named in the chunk; a function
+* whose side file is missing or does not match it stays stripped
+*/
+void luaU_loaddebug (lua_State* L, Proto* f)
+{
+ global_State* g=G(L);
+ TString* file=f->debugfile;
+ size_t size=(size_t)f->debugsize;
+ char* buff;
+ f->debugfile=NULL;			/* try only once */
+ if (g->debugloader==NULL) return;
+ buff=luaM_newvector(L,size,char);
+ if ((*g->debugloader)(g->debugud,getstr(file),(size_t)f->debugoffset,size,buff))
+ {
+  DebugLoad d;
+  DebugBuffer b;
+  ZIO z;
+  Mbuffer zbuff;
+  ptrdiff_t top=savestack(L,L->top);
+  b.s=buff;
+  b.size=size;
+  luaZ_init(L,&z,ReadDebug,&b);
+  luaZ_initbuffer(L,&zbuff);
+  d.S.L=L;
+  d.S.Z=&z;
+  d.S.b=&zbuff;
+  d.S.name=getstr(file);
+  d.f=f;
+  if (luaD_rawrunprotected(L,f_loaddebug,&d)!=0 ||
+      (f->sizelineinfo!=f->sizecode && f->sizelineinfo!=0) ||
+      f->sizeupvalues>f->nups)
+   FreeDebug(L,f);
+  else
+  {
+   int i;
+   for (i=0; i<f->sizelocvars; i++)	/* names were created after `f' */
+    if (f->locvars[i].varname) luaC_objbarrier(L,f,f->locvars[i].varname);
+   for (i=0; i<f->sizeupvalues; i++)
+    if (f->upvalues[i]) luaC_objbarrier(L,f,f->upvalues[i]);
+  }
+  L->top=restorestack(L,top);		/* remove eventual error message */
+  luaZ_freebuffer(L,&zbuff);
+ }
+ luaM_freearray(L,buff,size,char);
+}
+
 /*
 * make header
 */
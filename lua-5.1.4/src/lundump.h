@@ -16,9 +16,19 @@ LUAI_FUNC Proto* luaU_undump (lua_State* L, ZIO* Z, Mbuffer* buff, const char* n
 /* make header; from lundump.c */
 LUAI_FUNC void luaU_header (char* h);
 
+/* load debug information left in a side file; from lundump.c */
+LUAI_FUNC void luaU_loaddebug (lua_State* L, Proto* f);
+
+/* make sure the debug information of a function is loaded */
+#define luaU_needdebug(L,f)	{ if ((f)->debugfile) luaU_loaddebug(L,f); }
+
 /* dump one chunk; from ldump.c */
 LUAI_FUNC int luaU_dump (lua_State* L, const Proto* f, lua_Writer w, void* data, int strip);
 
+/* dump one chunk with its debug information in a side file; from ldump.c */
+LUAI_FUNC int luaU_dumpsplit (lua_State* L, const Proto* f, lua_Writer w, void* data,
+                              lua_Writer dw, void* ddata, const char* dname);
+
 #ifdef luac_c
 /* print one chunk; from print.c */
 LUAI_FUNC void luaU_print (const Proto* f, int full);
@@ -33,4 +43,7 @@ LUAI_FUNC void luaU_print (const Proto* f, int full);
 /* size of header of binary files */
 #define LUAC_HEADERSIZE		12
 
+/* size of line info that marks debug information kept in a side file */
+#define LUAC_SPLITDEBUG		(-1)
+
 #endif
@@ -24,6 +24,7 @@
 #include "lstring.h"
 #include "ltable.h"
 #include "ltm.h"
+#include "lundump.h"
 #include "lvm.h"
 
 
@@ -68,7 +69,9 @@ static void traceexec (lua_State *L, const Instruction *pc) {
   if (mask & LUA_MASKLINE) {
     Proto *p = ci_func(L->ci)->l.p;
     int npc = pcRel(pc, p);
-    int newline = getline(p, npc);
+    int newline;
+    luaU_needdebug(L, p);
+    newline = getline(p, npc);
     /* call linehook when enter a new function, when jump back (loop),
        or when enter a new line */
     if (npc == 0 || pc <= oldpc || newline != getline(p, pcRel(oldpc, p)))
@@ -158,6 +161,21 @@ void luaV_settable (lua_State *L, const TValue *t, TValue *key, StkId val) {
 }
 
 
+/*
+** If number `n' is an integer index into the array part of `h', return
+** its slot; otherwise return NULL. Lets the VM index arrays without
+** going through the generic key dispatch of `luaH_get'/`luaH_set'.
+*/
+static TValue *arrayslot (Table *h, lua_Number n) {
+  int k;
+  lua_number2int(k, n);
+  if (cast(unsigned int, k-1) < cast(unsigned int, h->sizearray) &&
+      luai_numeq(cast_num(k), n))
+    return &h->array[k-1];
+  return NULL;
+}
+
+
 static int call_binTM (lua_State *L, const TValue *p1, const TValue *p2,
                        StkId res, TMS event) {
   const TValue *tm = luaT_gettmbyobj(L, p1, event);  /* try first operand */
@@ -434,7 +452,18 @@ void luaV_execute (lua_State *L, int nexeccalls) {
         continue;
       }
       case OP_GETTABLE: {
-        Protect(luaV_gettable(L, RB(i), RKC(i), ra));
+        TValue *rb = RB(i);
+        TValue *rc = RKC(i);
+        if (ttistable(rb) && ttisnumber(rc)) {  /* array access? */
+          Table *h = hvalue(rb);
+          const TValue *res = arrayslot(h, nvalue(rc));
+          if (res != NULL &&
+              (!ttisnil(res) || fasttm(L, h->metatable, TM_INDEX) == NULL)) {
+            setobj2s(L, ra, res);
+            continue;
+          }
+        }
+        Protect(luaV_gettable(L, rb, rc, ra));
         continue;
       }
       case OP_SETGLOBAL: {
@@ -451,7 +480,19 @@ void luaV_execute (lua_State *L, int nexeccalls) {
         continue;
       }
       case OP_SETTABLE: {
-        Protect(luaV_settable(L, ra, RKB(i), RKC(i)));
+        TValue *rb = RKB(i);
+        TValue *rc = RKC(i);
+        if (ttistable(ra) && ttisnumber(rb)) {  /* array access? */
+          Table *h = hvalue(ra);
+          TValue *slot = arrayslot(h, nvalue(rb));
+          if (slot != NULL &&
+              (!ttisnil(slot) || fasttm(L, h->metatable, TM_NEWINDEX) == NULL)) {
+            setobj2t(L, slot, rc);
+            luaC_barriert(L, h, rc);
+            continue;
+          }
+        }
+        Protect(luaV_settable(L, ra, rb, rc));
         continue;
       }
       case OP_NEWTABLE: {
@@ -741,20 +782,18 @@ void luaV_execute (lua_State *L, int nexeccalls) {
         int j;
         CallInfo *ci = L->ci;
         int n = cast_int(ci->base - ci->func) - cl->p->numparams - 1;
+        StkId va;
         if (b == LUA_MULTRET) {
           Protect(luaD_checkstack(L, n));
           ra = RA(i);  /* previous call may change the stack */
           b = n;
           L->top = ra + n;
         }
-        for (j = 0; j < b; j++) {
-          if (j < n) {
-            setobjs2s(L, ra + j, ci->base - n + j);
-          }
-          else {
-            setnilvalue(ra + j);
-          }
-        }
+        va = ci->base - n;  /* varargs sit just below the frame base */
+        for (j = 0; j < b && j < n; j++)
+          setobjs2s(L, ra + j, va + j);
+        for (; j < b; j++)
+          setnilvalue(ra + j);
         continue;
       }
     }
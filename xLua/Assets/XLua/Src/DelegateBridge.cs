@@ -18,7 +18,9 @@ using LuaCSFunction = XLua.LuaDLL.lua_CSFunction;
 
 using System;
 using System.Collections.Generic;
+using System.Reflection;
 using System.Runtime.InteropServices;
+using System.Threading;
 
 namespace XLua
 {
@@ -122,6 +124,46 @@ namespace XLua
             xlua_set_hotfix_flag(idx, val != null);
 #endif
         }
+
+        static readonly object patchBitmapLock = new object();
+
+        // PatchBitmap模式注入的方法只检查所在Assembly的补丁位图，置位后才去读补丁委托字段，
+        // 所以给带HotfixPatchBitAttribute的字段赋值时要同步位图：先设字段再置位，先清位再清字段，
+        // 中间加内存屏障保证顺序；注入的桩仍会判空，读到旧位时回到原方法体
+        public static void SetPatchField(FieldInfo field, object val)
+        {
+            var attrs = field.IsStatic ? field.GetCustomAttributes(typeof(HotfixPatchBitAttribute), false) : null;
+            FieldInfo bits = null;
+            int bit = 0;
+            if (attrs != null && attrs.Length > 0)
+            {
+                bit = ((HotfixPatchBitAttribute)attrs[0]).Bit;
+                var bitmapType = field.DeclaringType.Assembly.GetType("XLua.<HotfixPatchBitmap>");
+                if (bitmapType != null)
+                {
+                    bits = bitmapType.GetField("Bits" + (bit >> 5), BindingFlags.Public | BindingFlags.NonPublic | BindingFlags.Static);
+                }
+            }
+            if (bits == null)
+            {
+                field.SetValue(null, val);
+                return;
+            }
+            lock (patchBitmapLock)
+            {
+                if (val == null)
+                {
+                    bits.SetValue(null, (int)bits.GetValue(null) & ~(1 << (bit & 31)));
+                    Thread.MemoryBarrier();
+                }
+                field.SetValue(null, val);
+                if (val != null)
+                {
+                    Thread.MemoryBarrier();
+                    bits.SetValue(null, (int)bits.GetValue(null) | (1 << (bit & 31)));
+                }
+            }
+        }
     }
 
     public partial class DelegateBridge : DelegateBridgeBase
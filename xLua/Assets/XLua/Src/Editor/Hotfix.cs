@@ -170,6 +170,7 @@ namespace XLua
         AdaptByDelegate = 64,
         IgnoreCompilerGenerated = 128,
         NoBaseProxy = 256,
+        PatchBitmap = 512,
     }
 
     static class ExtentionMethods
@@ -278,6 +279,11 @@ namespace XLua
 
         private List<MethodDefinition> bridgeIndexByKey = null;
 
+        private MethodReference patchBitCtor = null;
+        private TypeDefinition patchBitmapType = null;
+        private int patchBitCount = 0;
+        private List<MethodDefinition> patchStubs = null;
+
         private bool isTheSameAssembly = false;
 
         private int delegateId = 0;
@@ -316,6 +322,12 @@ namespace XLua
 
             bridgeIndexByKey = new List<MethodDefinition>();
 
+            var patchBitAttributeType = xluaAssembly.MainModule.Types.SingleOrDefault(t => t.FullName == "XLua.HotfixPatchBitAttribute");
+            patchBitCtor = patchBitAttributeType == null ? null : injectModule.TryImport(patchBitAttributeType.Methods.Single(m => m.IsConstructor));
+            patchBitmapType = null;
+            patchBitCount = 0;
+            patchStubs = new List<MethodDefinition>();
+
             var resolverOfInjectAssembly = injectAssembly.MainModule.AssemblyResolver as BaseAssemblyResolver;
             var resolverOfXluaAssembly = xluaAssembly.MainModule.AssemblyResolver as BaseAssemblyResolver;
             if (!isTheSameAssembly)
@@ -749,6 +761,12 @@ namespace XLua
                 }
             }
 
+            foreach (var stub in patchStubs)
+            {
+                type.Methods.Add(stub);
+            }
+            patchStubs.Clear();
+
             if (!noBaseProxy)
             {
                 List<MethodDefinition> toAdd = new List<MethodDefinition>();
@@ -932,6 +950,42 @@ namespace XLua
 
         static readonly int MAX_OVERLOAD = 100;
 
+        static OpCode[] ldcI4s = new OpCode[] { OpCodes.Ldc_I4_0, OpCodes.Ldc_I4_1, OpCodes.Ldc_I4_2, OpCodes.Ldc_I4_3, OpCodes.Ldc_I4_4,
+            OpCodes.Ldc_I4_5, OpCodes.Ldc_I4_6, OpCodes.Ldc_I4_7, OpCodes.Ldc_I4_8 };
+
+        //注入代码越短，JIT越可能内联被注入的方法
+        static Instruction createLdcI4(ILProcessor processor, int value)
+        {
+            if (value >= 0 && value < ldcI4s.Length)
+            {
+                return processor.Create(ldcI4s[value]);
+            }
+            else if (value >= sbyte.MinValue && value <= sbyte.MaxValue)
+            {
+                return processor.Create(OpCodes.Ldc_I4_S, (sbyte)value);
+            }
+            else
+            {
+                return processor.Create(OpCodes.Ldc_I4, value);
+            }
+        }
+
+        static Instruction createLdarg(ILProcessor processor, int i)
+        {
+            if (i < ldargs.Length)
+            {
+                return processor.Create(ldargs[i]);
+            }
+            else if (i < 256)
+            {
+                return processor.Create(OpCodes.Ldarg_S, (byte)i);
+            }
+            else
+            {
+                return processor.Create(OpCodes.Ldarg, (short)i);
+            }
+        }
+
         static string getDelegateName(MethodDefinition method)
         {
             string fieldName = method.Name;
@@ -1197,11 +1251,16 @@ namespace XLua
             VariableDefinition injection = null;
             bool isIntKey = hotfixType.HasFlag(HotfixFlagInTool.IntKey) && !type.HasGenericParameters && isTheSameAssembly;
             //isIntKey = !type.HasGenericParameters;
+            bool isPatchBitmap = hotfixType.HasFlag(HotfixFlagInTool.PatchBitmap) && !isIntKey && !type.HasGenericParameters
+                && !method.IsConstructor && !isFinalize && patchBitCtor != null;
 
             if (!isIntKey)
             {
-                injection = new VariableDefinition(invoke.DeclaringType);
-                method.Body.Variables.Add(injection);
+                if (!isPatchBitmap)
+                {
+                    injection = new VariableDefinition(invoke.DeclaringType);
+                    method.Body.Variables.Add(injection);
+                }
 
                 var luaDelegateName = getDelegateName(method);
                 if (luaDelegateName == null)
@@ -1214,10 +1273,23 @@ namespace XLua
                     invoke.DeclaringType);
                 type.Fields.Add(fieldDefinition);
                 fieldReference = fieldDefinition.GetGeneric();
+
+                if (isPatchBitmap)
+                {
+                    var patchBit = new CustomAttribute(patchBitCtor);
+                    patchBit.ConstructorArguments.Add(new CustomAttributeArgument(injectAssembly.MainModule.TypeSystem.Int32, patchBitCount));
+                    fieldDefinition.CustomAttributes.Add(patchBit);
+                }
             }
 
             bool ignoreValueType = hotfixType.HasFlag(HotfixFlagInTool.ValueTypeBoxing);
 
+            if (isPatchBitmap)
+            {
+                injectPatchBitmapCheck(method, fieldReference, invoke, param_count, ignoreValueType);
+                return true;
+            }
+
             var insertPoint = method.Body.Instructions[0];
             var processor = method.Body.GetILProcessor();
 
@@ -1335,6 +1407,140 @@ namespace XLua
             return true;
         }
 
+        const string PATCH_BITMAP_TYPE_NAME = "<HotfixPatchBitmap>";
+        const string PATCH_STUB_PERFIX = "<>xLuaHotfixStub";
+
+        //PatchBitmap模式：方法入口只检查所在Assembly补丁位图中的一位，不打补丁时只多一次读和一次分支；
+        //位图每32位一个静态int字段（Bits0、Bits1...），不用数组省掉边界检查；
+        //取委托、压参数、调用补丁都挪到不内联的桩方法里，调用桩的代码放到方法末尾；
+        //位和委托字段不是原子地一起变的，桩只读一次字段，为null时返回false，调用方接着执行原方法体，
+        //有返回值的方法通过桩最后的out参数取返回值
+        void injectPatchBitmapCheck(MethodDefinition method, FieldReference fieldReference, MethodReference invoke, int param_count, bool ignoreValueType)
+        {
+            var type = method.DeclaringType;
+            var module = injectAssembly.MainModule;
+            if (patchBitmapType == null)
+            {
+                patchBitmapType = new TypeDefinition("XLua", PATCH_BITMAP_TYPE_NAME, Mono.Cecil.TypeAttributes.Class | Mono.Cecil.TypeAttributes.Abstract
+                    | Mono.Cecil.TypeAttributes.Sealed | Mono.Cecil.TypeAttributes.BeforeFieldInit, objType);
+                module.Types.Add(patchBitmapType);
+            }
+            int bit = patchBitCount++;
+            if ((bit & 31) == 0)
+            {
+                patchBitmapType.Fields.Add(new FieldDefinition("Bits" + (bit >> 5), Mono.Cecil.FieldAttributes.Static | Mono.Cecil.FieldAttributes.Public,
+                    module.TypeSystem.Int32));
+            }
+
+            bool isVoid = method.ReturnType.FullName == "System.Void";
+            var stub = new MethodDefinition(PATCH_STUB_PERFIX + fieldReference.Name, Mono.Cecil.MethodAttributes.Private | Mono.Cecil.MethodAttributes.Static
+                | Mono.Cecil.MethodAttributes.HideBySig, module.TypeSystem.Boolean);
+            stub.ImplAttributes |= Mono.Cecil.MethodImplAttributes.NoInlining;
+            var patch = new VariableDefinition(invoke.DeclaringType);
+            stub.Body.Variables.Add(patch);
+            stub.Body.InitLocals = true;
+            for (int i = 0; i < param_count; i++)
+            {
+                TypeReference paramType;
+                if (method.IsStatic)
+                {
+                    paramType = method.Parameters[i].ParameterType;
+                }
+                else
+                {
+                    paramType = (i == 0) ? type : method.Parameters[i - 1].ParameterType;
+                }
+                stub.Parameters.Add(new ParameterDefinition("P" + i, Mono.Cecil.ParameterAttributes.None, paramType));
+            }
+            if (!isVoid)
+            {
+                stub.Parameters.Add(new ParameterDefinition("ret", Mono.Cecil.ParameterAttributes.Out, new ByReferenceType(method.ReturnType)));
+            }
+            var stubProcessor = stub.Body.GetILProcessor();
+            var notPatched = stubProcessor.Create(OpCodes.Ldc_I4_0);
+            stubProcessor.Append(stubProcessor.Create(OpCodes.Ldsfld, fieldReference));
+            stubProcessor.Append(stubProcessor.Create(OpCodes.Stloc, patch));
+            stubProcessor.Append(stubProcessor.Create(OpCodes.Ldloc, patch));
+            stubProcessor.Append(stubProcessor.Create(OpCodes.Brfalse, notPatched));
+            if (!isVoid)
+            {
+                stubProcessor.Append(createLdarg(stubProcessor, param_count));
+            }
+            stubProcessor.Append(stubProcessor.Create(OpCodes.Ldloc, patch));
+            for (int i = 0; i < param_count; i++)
+            {
+                stubProcessor.Append(createLdarg(stubProcessor, i));
+                if (ignoreValueType && stub.Parameters[i].ParameterType.IsValueType)
+                {
+                    stubProcessor.Append(stubProcessor.Create(OpCodes.Box, stub.Parameters[i].ParameterType));
+                }
+            }
+            stubProcessor.Append(stubProcessor.Create(OpCodes.Call, invoke));
+            if (!isVoid)
+            {
+                stubProcessor.Append(stubProcessor.Create(OpCodes.Stobj, method.ReturnType));
+            }
+            stubProcessor.Append(stubProcessor.Create(OpCodes.Ldc_I4_1));
+            stubProcessor.Append(stubProcessor.Create(OpCodes.Ret));
+            stubProcessor.Append(notPatched);
+            stubProcessor.Append(stubProcessor.Create(OpCodes.Ret));
+            patchStubs.Add(stub);
+
+            var processor = method.Body.GetILProcessor();
+            var instructions = method.Body.Instructions;
+            var insertPoint = instructions[0];
+            var body = processor.Create(OpCodes.Nop); // 桩返回false时跳回这里，不能直接跳到可能是try开头的原第一条指令
+            VariableDefinition ret = null;
+            if (!isVoid)
+            {
+                ret = new VariableDefinition(method.ReturnType);
+                method.Body.Variables.Add(ret);
+                method.Body.InitLocals = true;
+            }
+            var slowPath = new List<Instruction>();
+            for (int i = 0; i < param_count; i++)
+            {
+                slowPath.Add(createLdarg(processor, i));
+                if (i == 0 && !method.IsStatic && type.IsValueType)
+                {
+                    slowPath.Add(processor.Create(OpCodes.Ldobj, type));
+                }
+            }
+            if (!isVoid)
+            {
+                slowPath.Add(processor.Create(OpCodes.Ldloca, ret));
+            }
+            slowPath.Add(processor.Create(OpCodes.Call, stub));
+            slowPath.Add(processor.Create(OpCodes.Brfalse, body));
+            if (!isVoid)
+            {
+                slowPath.Add(processor.Create(OpCodes.Ldloc, ret));
+            }
+            slowPath.Add(processor.Create(OpCodes.Ret));
+
+            processor.InsertBefore(insertPoint, processor.Create(OpCodes.Ldsfld, patchBitmapType.Fields[bit >> 5]));
+            processor.InsertBefore(insertPoint, createLdcI4(processor, 1 << (bit & 31)));
+            processor.InsertBefore(insertPoint, processor.Create(OpCodes.And));
+            processor.InsertBefore(insertPoint, processor.Create(OpCodes.Brtrue, slowPath[0]));
+            processor.InsertBefore(insertPoint, body);
+
+            foreach (var handler in method.Body.ExceptionHandlers) // 结尾的try/catch不能把桩调用包进去
+            {
+                if (handler.TryEnd == null)
+                {
+                    handler.TryEnd = slowPath[0];
+                }
+                if (handler.HandlerEnd == null)
+                {
+                    handler.HandlerEnd = slowPath[0];
+                }
+            }
+            foreach (var instruction in slowPath)
+            {
+                processor.Append(instruction);
+            }
+        }
+
         bool injectGenericMethod(MethodDefinition method, HotfixFlagInTool hotfixType)
         {
             //如果注入的是xlua所在之外的Assembly的话，不支持该方式
@@ -103,6 +103,7 @@ namespace XLua
         AdaptByDelegate = 64,
         IgnoreCompilerGenerated = 128,
         NoBaseProxy = 256,
+        PatchBitmap = 512,
     }
 
     public class HotfixAttribute : Attribute
@@ -127,6 +128,25 @@ namespace XLua
     {
     }
 
+    //PatchBitmap模式注入时加到补丁委托字段上，记录该字段在所在Assembly补丁位图中的位
+    [AttributeUsage(AttributeTargets.Field)]
+    public class HotfixPatchBitAttribute : Attribute
+    {
+        int bit;
+        public int Bit
+        {
+            get
+            {
+                return bit;
+            }
+        }
+
+        public HotfixPatchBitAttribute(int bit)
+        {
+            this.bit = bit;
+        }
+    }
+
 #if !XLUA_GENERAL
     public static class SysGenConfig
     {
@@ -24,9 +24,8 @@ namespace XLua
 {
     internal partial class InternalGlobals
     {
-#if !THREAD_SAFE && !HOTFIX_ENABLE
-        internal static byte[] strBuff = new byte[256];
-#endif
+        // lua_tostring 的解码结果，按 xlua.c 字符串缓存的槽位存放，所有 LuaEnv 共用
+        internal static LuaDLL.Lua.StringCacheEntry[] strCache = new LuaDLL.Lua.StringCacheEntry[LuaDLL.Lua.STRING_CACHE_SIZE];
 
         internal delegate bool TryArrayGet(Type type, RealStatePtr L, ObjectTranslator translator, object obj, int index);
         internal delegate bool TryArraySet(Type type, RealStatePtr L, ObjectTranslator translator, object obj, int array_idx, int obj_idx);
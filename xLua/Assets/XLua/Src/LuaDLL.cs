@@ -187,10 +187,32 @@ namespace XLua.LuaDLL
 		[DllImport(LUADLL,CallingConvention=CallingConvention.Cdecl)]
 		public static extern int luaL_ref(IntPtr L, int registryIndex);
 
-        public static int luaL_ref(IntPtr L)//[-1, +0, m]
-        {
-			return luaL_ref(L,LuaIndexes.LUA_REGISTRYINDEX);
-		}
+        // 把栈顶对象放入句柄表并返回句柄（弹出栈顶对象），nil返回0
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int xlua_ref(IntPtr L);//[-1, +0, m]
+
+        // 压入句柄指向的对象，句柄已失效时压入nil并返回0
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int xlua_getref(IntPtr L, int reference);
+
+        // 释放句柄，句柄已失效时返回0
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int xlua_unref(IntPtr L, int reference);
+
+        // 一次释放refs中的前n个句柄，返回其中未失效的个数
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int xlua_unref_batch(IntPtr L, int[] refs, int n);
+
+        // 把常量字符串驻留为键句柄，之后可用xlua_getfield_key/xlua_setfield_key免去每次的哈希和查找
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int xlua_key(IntPtr L, byte[] str, int len);
+
+        // 同lua_getfield，但键为xlua_key返回的句柄，返回值为压栈值的类型
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int xlua_getfield_key(IntPtr L, int idx, int key);
+
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void xlua_setfield_key(IntPtr L, int idx, int key);
 
         // 把 t[index] 的值压栈， 这里的 t 是指给定{tableIndex}处的表。 这是一次直接访问；就是说，它不会触发元方法。
 		[DllImport(LUADLL,CallingConvention=CallingConvention.Cdecl)]
@@ -200,10 +222,10 @@ namespace XLua.LuaDLL
 		[DllImport(LUADLL,CallingConvention=CallingConvention.Cdecl)]
 		public static extern void xlua_rawseti(IntPtr L, int tableIndex, long index);//[-1, +0, m]
 
-        // 获取注册表reference处索引的值
+        // 获取句柄reference指向的值
         public static void lua_getref(IntPtr L, int reference)
 		{
-			xlua_rawgeti(L,LuaIndexes.LUA_REGISTRYINDEX,reference);
+			xlua_getref(L, reference);
 		}
 
         [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
@@ -214,7 +236,7 @@ namespace XLua.LuaDLL
 
 		public static void lua_unref(IntPtr L, int reference)
 		{
-			luaL_unref(L,LuaIndexes.LUA_REGISTRYINDEX,reference);
+			xlua_unref(L, reference);
 		}
 
 		[DllImport(LUADLL,CallingConvention=CallingConvention.Cdecl)]
@@ -260,29 +282,51 @@ namespace XLua.LuaDLL
         [DllImport(LUADLL,CallingConvention = CallingConvention.Cdecl)]
 		public static extern IntPtr lua_tolstring(IntPtr L, int index, out IntPtr strLen);//[-0, +0, m]
 
+        // 与 lua_tolstring 相同，另外返回字符串缓存的槽位（不缓存时为 -1）和标志位，见 xlua.c
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr xlua_tolstring_cached(IntPtr L, int index, out IntPtr strLen, out int slot, out int flags);
+
+        // 需与 xlua.c 的 STRCACHE_SIZE、STR_HIT、STR_ASCII 保持一致
+        internal const int STRING_CACHE_SIZE = 1024;
+        const int STRING_CACHE_HIT = 1;
+        const int STRING_ASCII = 2;
+
+        internal class StringCacheEntry
+        {
+            public readonly IntPtr ptr;
+            public readonly string str;
+
+            public StringCacheEntry(IntPtr ptr, string str)
+            {
+                this.ptr = ptr;
+                this.str = str;
+            }
+        }
+
         public static string lua_tostring(IntPtr L, int index)
 		{
             IntPtr strlen;
+            int slot, flags;
 
-            IntPtr str = lua_tolstring(L, index, out strlen);
+            IntPtr str = xlua_tolstring_cached(L, index, out strlen, out slot, out flags);
             if (str != IntPtr.Zero)
 			{
-#if XLUA_GENERAL || (UNITY_WSA && !UNITY_EDITOR)
-                int len = strlen.ToInt32();
-                byte[] buffer = new byte[len];
-                Marshal.Copy(str, buffer, 0, len);
-                return Encoding.UTF8.GetString(buffer);
-#else
-                string ret = Marshal.PtrToStringAnsi(str, strlen.ToInt32());
-                if (ret == null)
+                // 命中时该槽位的 lua 字符串未变，直接复用上次解码的结果
+                if ((flags & STRING_CACHE_HIT) != 0)
+                {
+                    StringCacheEntry entry = InternalGlobals.strCache[slot];
+                    if (entry != null && entry.ptr == str)
+                    {
+                        return entry.str;
+                    }
+                }
+
+                string ret = decode_string(str, strlen.ToInt32(), (flags & STRING_ASCII) != 0);
+                if (slot >= 0)
                 {
-                    int len = strlen.ToInt32();
-                    byte[] buffer = new byte[len];
-                    Marshal.Copy(str, buffer, 0, len);
-                    return Encoding.UTF8.GetString(buffer);
+                    InternalGlobals.strCache[slot] = new StringCacheEntry(str, ret);
                 }
                 return ret;
-#endif
             }
             else
 			{
@@ -290,6 +334,31 @@ namespace XLua.LuaDLL
 			}
 		}
 
+        static string decode_string(IntPtr str, int len, bool ascii)
+        {
+#if !(UNITY_WSA && !UNITY_EDITOR)
+            // 纯 ASCII 在任何 ANSI 编码下结果都一样，免去中间的 byte[]
+            if (ascii)
+            {
+                return Marshal.PtrToStringAnsi(str, len);
+            }
+#endif
+#if XLUA_GENERAL || (UNITY_WSA && !UNITY_EDITOR)
+            byte[] buffer = new byte[len];
+            Marshal.Copy(str, buffer, 0, len);
+            return Encoding.UTF8.GetString(buffer);
+#else
+            string ret = Marshal.PtrToStringAnsi(str, len);
+            if (ret == null)
+            {
+                byte[] buffer = new byte[len];
+                Marshal.Copy(str, buffer, 0, len);
+                return Encoding.UTF8.GetString(buffer);
+            }
+            return ret;
+#endif
+        }
+
         [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
 		public static extern IntPtr lua_atpanic(IntPtr L, lua_CSFunction panicf);
 
@@ -309,6 +378,10 @@ namespace XLua.LuaDLL
         [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
         public static extern void lua_pushstring(IntPtr L, string str);
 #else
+        // 直接把 C# 字符串的 UTF-16 内容交给 native 转成 UTF-8，不经过中间的 byte[]
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void xlua_pushutf16(IntPtr L, [MarshalAs(UnmanagedType.LPWStr)] string str, int len);
+
         public static void lua_pushstring(IntPtr L, string str) //业务使用
         {
             if (str == null)
@@ -317,21 +390,7 @@ namespace XLua.LuaDLL
             }
             else
             {
-#if !THREAD_SAFE && !HOTFIX_ENABLE
-                if (Encoding.UTF8.GetByteCount(str) > InternalGlobals.strBuff.Length)
-                {
-                    byte[] bytes = Encoding.UTF8.GetBytes(str);
-                    xlua_pushlstring(L, bytes, bytes.Length);
-                }
-                else
-                {
-                    int bytes_len = Encoding.UTF8.GetBytes(str, 0, str.Length, InternalGlobals.strBuff, 0);
-                    xlua_pushlstring(L, InternalGlobals.strBuff, bytes_len);
-                }
-#else
-                var bytes = Encoding.UTF8.GetBytes(str);
-                xlua_pushlstring(L, bytes, bytes.Length);
-#endif
+                xlua_pushutf16(L, str, str.Length);
             }
         }
 #endif
@@ -351,19 +410,7 @@ namespace XLua.LuaDLL
 #if NATIVE_LUA_PUSHSTRING
                 lua_pushstring(L, str);
 #else
-#if !THREAD_SAFE && !HOTFIX_ENABLE
-                int str_len = str.Length;
-                if (InternalGlobals.strBuff.Length < str_len)
-                {
-                    InternalGlobals.strBuff = new byte[str_len];
-                }
-
-                int bytes_len = Encoding.UTF8.GetBytes(str, 0, str_len, InternalGlobals.strBuff, 0);
-                xlua_pushlstring(L, InternalGlobals.strBuff, bytes_len);
-#else
-                var bytes = Encoding.UTF8.GetBytes(str);
-                xlua_pushlstring(L, bytes, bytes.Length);
-#endif
+                xlua_pushutf16(L, str, str.Length);
 #endif
             }
         }
@@ -458,6 +505,10 @@ namespace XLua.LuaDLL
         [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
         public static extern int xlua_tryget_cachedud(IntPtr L, int key, int cache_ref);
 
+        // 标记key对应对象的lua代理已销毁，之后在lua中索引它会直接报错；lua中没有其代理时返回0
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int xlua_markdestroyed(IntPtr L, int key, int cache_ref);
+
         // 真正将对象push到lua的方法，将在lua中创建一个userdata并将其指向key，然后为userdata设置meta_ref的元表，这样该userdata就成为了key表示的CS对象的lua代理
         // key表示C#侧缓存该对象的索引
         // meta_ref表示对象所属类型的元表的索引
@@ -466,11 +517,26 @@ namespace XLua.LuaDLL
         [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
         public static extern void xlua_pushcsobj(IntPtr L, int key, int meta_ref, bool need_cache, int cache_ref);//[-0, +1, m]
 
+        // 同 xlua_pushcsobj，另外记下已固定（pinned）的基元类型数组的地址、元素类型和长度，arr[i] 由 native 直接读写
+        // type 取 xlua.c 中的 T_INT8 ~ T_DOUBLE 或 T_BOOL
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void xlua_pusharray(IntPtr L, int key, int meta_ref, bool need_cache, int cache_ref, IntPtr data, int type, int len);//[-0, +1, m]
+
+        // 解除固定前调用，之后该代理回到托管的数组访问
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void xlua_releasearray(IntPtr L, int index);
+
+        // 用栈顶的托管 Length getter 创建闭包，native 数组直接返回长度
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int gen_array_length(IntPtr L);
+
         /*
         // 创建一个__index函数闭包，__index调用时需要2个参数，obj和key
         // 创建闭包时栈上需要7个关联upvalue
         // [1]: methods, [2]:getters, [3]:csindexer, [4]:base, [5]:indexfuncs, [6]:arrayindexer, [7]:baseindex
         __index索引逻辑
+        0. 如果obj是xlua_pusharray压入的基元类型数组且key是数字，直接在native读取元素
+           有成员索引（gen_obj_indexer_indexed）且key是其中的方法或getter，直接返回或调用，不查methods/getters表
         1. 如果methods中有key，则压栈methods[key]。查询成员方法或事件
         2. 如果getters中有key，则调用getters[key]。查询成员字段或属性
         3. 如果arrayindexer中有key且key是数字，则调用arrayindexer[key]
@@ -498,6 +564,19 @@ namespace XLua.LuaDLL
         [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]//[,,m]
         public static extern int gen_obj_newindexer(IntPtr L);
 
+        // 为生成代码的类型建成员索引：按names从methods/getters/setters表取出函数，压入索引和存放函数的表两个值
+        // Lua的短字符串是驻留的，obj_indexer按key字符串的地址查找，不再做表查询
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]//[,,m]
+        public static extern void xlua_pushmemberindex(IntPtr L, int methods, int getters, int setters, string[] names, int count);
+
+        // 同gen_obj_indexer，栈顶多出xlua_pushmemberindex压入的两个值，成为第8、9个upvalue
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]//[,,m]
+        public static extern int gen_obj_indexer_indexed(IntPtr L);
+
+        // 同gen_obj_newindexer，栈顶多出xlua_pushmemberindex压入的两个值，成为第7、8个upvalue
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]//[,,m]
+        public static extern int gen_obj_newindexer_indexed(IntPtr L);
+
         /*
         // 为类的静态域创建一个__index函数闭包，__index调用时需要2个参数，obj和key
         // 创建闭包时栈上需要5个关联upvalue
@@ -523,6 +602,9 @@ namespace XLua.LuaDLL
         [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
         public static extern int luaopen_i64lib(IntPtr L);//[,,m]
 
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int xlua_scheduler_tick(IntPtr L, double now);
+
 #if (!UNITY_SWITCH && !UNITY_WEBGL) || UNITY_EDITOR
         [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
         public static extern int luaopen_socket_core(IntPtr L);//[,,m]
@@ -599,6 +681,10 @@ namespace XLua.LuaDLL
         [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
         public static extern int xlua_gettypeid(IntPtr L, int idx);
 
+        // [xlua.c] 一次取得所有参数的类型签名，用于重载选择的缓存，返回参数个数，-1表示不能缓存
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int xlua_argsignature(IntPtr L, int[] sig, int max);
+
         // 返回lua提供的注册表的有效伪索引
         [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
         public static extern int xlua_get_registry_index();
@@ -650,6 +736,16 @@ namespace XLua.LuaDLL
         [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
         public static extern IntPtr xlua_gl(IntPtr L);
 
+        // 返回1表示之后可以用xlua_gettranslator直接从L读出id
+        [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int xlua_settranslator(IntPtr L, int id);
+
+        // 不经过P/Invoke：L前面的extraspace存着HandleTable指针，其第一个字段就是xlua_settranslator设置的id
+        public static int xlua_gettranslator(IntPtr L)
+        {
+            return Marshal.ReadInt32(Marshal.ReadIntPtr(L, -IntPtr.Size));
+        }
+
 #if GEN_CODE_MINIMIZE
         [DllImport(LUADLL, CallingConvention = CallingConvention.Cdecl)]
         public static extern void xlua_set_csharp_wrapper_caller(IntPtr wrapper);
@@ -21,6 +21,7 @@ namespace XLua
 {
     using System;
     using System.Collections.Generic;
+    using System.Threading;
 
     public class LuaEnv : IDisposable
     {
@@ -336,6 +337,26 @@ namespace XLua
         Func<object, bool> object_valid_checker = new Func<object, bool>(ObjectValidCheck);
 #endif
 
+        /// <summary>
+        /// 为true时由业务在对象销毁时调用ObjectDestroyed通知，Tick不再轮询检查对象池
+        /// </summary>
+        public bool NotifyObjectDestroyed { get; set; }
+
+        /// <summary>
+        /// 通知obj已销毁：从对象池移除，并标记其lua代理，之后lua中访问该代理会立即报错
+        /// </summary>
+        public void ObjectDestroyed(object obj)
+        {
+#if THREAD_SAFE || HOTFIX_ENABLE
+            lock (luaEnvLock)
+            {
+#endif
+                translator.ObjectDestroyed(L, obj);
+#if THREAD_SAFE || HOTFIX_ENABLE
+            }
+#endif
+        }
+
         public void Tick()
         {
 #if THREAD_SAFE || HOTFIX_ENABLE
@@ -343,22 +364,58 @@ namespace XLua
             {
 #endif
                 var _L = L;
-                lock (refQueue)
+                int unrefCount = 0;
+                for (GCActionNode node = Interlocked.Exchange(ref pendingGCActions, null); node != null; node = node.Next)
                 {
-                    while (refQueue.Count > 0)
+                    if (node.Action.IsDelegate)
+                    {
+                        translator.ReleaseLuaBase(_L, node.Action.Reference, true);
+                    }
+                    else
                     {
-                        GCAction gca = refQueue.Dequeue();
-                        translator.ReleaseLuaBase(_L, gca.Reference, gca.IsDelegate);
+                        unrefBuffer[unrefCount++] = node.Action.Reference;
+                        if (unrefCount == unrefBuffer.Length)
+                        {
+                            LuaAPI.xlua_unref_batch(_L, unrefBuffer, unrefCount);
+                            unrefCount = 0;
+                        }
                     }
                 }
+                if (unrefCount > 0)
+                {
+                    LuaAPI.xlua_unref_batch(_L, unrefBuffer, unrefCount);
+                }
 #if !XLUA_GENERAL
-                last_check_point = translator.objects.Check(last_check_point, max_check_per_tick, object_valid_checker, translator.reverseMap);
+                if (!NotifyObjectDestroyed)
+                {
+                    last_check_point = translator.objects.Check(last_check_point, max_check_per_tick, object_valid_checker, translator.reverseMap);
+                }
 #endif
 #if THREAD_SAFE || HOTFIX_ENABLE
             }
 #endif
         }
 
+        // 驱动xlua.scheduler：now为毫秒，返回本次恢复的协程数
+        public int TickScheduler(double now)
+        {
+#if THREAD_SAFE || HOTFIX_ENABLE
+            lock (luaEnvLock)
+            {
+#endif
+                var _L = L;
+                int oldTop = LuaAPI.lua_gettop(_L);
+                int resumed = LuaAPI.xlua_scheduler_tick(_L, now);
+                if (resumed < 0)
+                {
+                    ThrowExceptionFromError(oldTop);
+                }
+                return resumed;
+#if THREAD_SAFE || HOTFIX_ENABLE
+            }
+#endif
+        }
+
         //兼容API
         public void GC()
         {
@@ -415,6 +472,7 @@ namespace XLua
                 ObjectTranslatorPool.Instance.Remove(L);
 
                 LuaAPI.lua_close(L);
+                translator.ReleasePinnedArrays();
                 translator = null;
 
                 rawL = IntPtr.Zero;
@@ -452,14 +510,27 @@ namespace XLua
             public bool IsDelegate;
         }
 
-        Queue<GCAction> refQueue = new Queue<GCAction>();
+        class GCActionNode
+        {
+            public GCAction Action;
+            public GCActionNode Next;
+        }
+
+        // 终结器线程无锁压入的待释放引用，Tick在主线程一次全部取走
+        GCActionNode pendingGCActions = null;
+
+        // 非delegate的引用攒到这里，每满一次或取完时调一次xlua_unref_batch释放，缓冲区大小固定
+        readonly int[] unrefBuffer = new int[256];
 
         internal void equeueGCAction(GCAction action)
         {
-            lock (refQueue)
+            GCActionNode node = new GCActionNode { Action = action };
+            GCActionNode head;
+            do
             {
-                refQueue.Enqueue(action);
-            }
+                head = pendingGCActions;
+                node.Next = head;
+            } while (Interlocked.CompareExchange(ref pendingGCActions, node, head) != head);
         }
         
         /// <summary>
@@ -287,6 +287,17 @@ namespace XLua
         private List<OverloadMethodWrap> overloads = new List<OverloadMethodWrap>();
         private bool forceCheck;
 
+        // 重载选择的缓存：参数的类型签名（见xlua_argsignature）相同时，Check的结果也相同，直接调用上次选中的重载
+        // 前提是校验器只依据Lua类型和C#类型做判断，自定义的校验器如果还要看table的内容，就不能用这个缓存
+        const int SIGNATURE_MAX_ARGS = 16;
+        const int SIGNATURE_CACHE_SIZE = 8;
+        private MethodWrapsCache cache;
+        private int[] signature = new int[SIGNATURE_MAX_ARGS];
+        private int[][] cachedSignatures = new int[SIGNATURE_CACHE_SIZE][];
+        private OverloadMethodWrap[] cachedOverloads = new OverloadMethodWrap[SIGNATURE_CACHE_SIZE];
+        private int cachedCount = 0;
+        private int nextReplace = 0;
+
         public MethodWrap(string methodName, List<OverloadMethodWrap> overloads, bool forceCheck)
         {
             this.methodName = methodName;
@@ -294,6 +305,48 @@ namespace XLua
             this.forceCheck = forceCheck;
         }
 
+        internal MethodWrap(MethodWrapsCache cache, string methodName, List<OverloadMethodWrap> overloads, bool forceCheck)
+            : this(methodName, overloads, forceCheck)
+        {
+            this.cache = cache;
+        }
+
+        // 取当前参数的签名，返回参数个数，-1表示不能缓存
+        int getSignature(RealStatePtr L)
+        {
+            int n = LuaAPI.xlua_argsignature(L, signature, SIGNATURE_MAX_ARGS);
+            for (int i = 0; i < n; i++)
+            {
+                if (signature[i] >= 16 && cache.translator.IsSharedTypeId(signature[i] - 16))
+                {
+                    return -1;
+                }
+            }
+            return n;
+        }
+
+        OverloadMethodWrap findCached(int n)
+        {
+            for (int i = 0; i < cachedCount; i++)
+            {
+                var sig = cachedSignatures[i];
+                if (sig.Length != n) continue;
+                int j = 0;
+                while (j < n && sig[j] == signature[j]) j++;
+                if (j == n) return cachedOverloads[i];
+            }
+            return null;
+        }
+
+        void addCached(int n, OverloadMethodWrap overload)
+        {
+            int slot = cachedCount < SIGNATURE_CACHE_SIZE ? cachedCount++ : nextReplace++ % SIGNATURE_CACHE_SIZE;
+            var sig = new int[n];
+            Array.Copy(signature, sig, n);
+            cachedSignatures[slot] = sig;
+            cachedOverloads[slot] = overload;
+        }
+
         // 通过调用此方法，触发选择MethodWrap中包裹的哪个重载函数并调用
         public int Call(RealStatePtr L)
         {
@@ -301,11 +354,24 @@ namespace XLua
             {
                 if (overloads.Count == 1 && !overloads[0].HasDefalutValue && !forceCheck) return overloads[0].Call(L);
 
+                int n = cache == null ? -1 : getSignature(L);
+                if (n >= 0)
+                {
+                    var cached = findCached(n);
+                    if (cached != null)
+                    {
+                        cache.OverloadCacheHits++;
+                        return cached.Call(L);
+                    }
+                }
+                if (cache != null) cache.OverloadCacheMisses++;
+
                 for (int i = 0; i < overloads.Count; ++i)
                 {
                     var overload = overloads[i];
                     if (overload.Check(L))
                     {
+                        if (n >= 0) addCached(n, overload);
                         return overload.Call(L);
                     }
                 }
@@ -324,7 +390,11 @@ namespace XLua
 
     public class MethodWrapsCache
     {
-        ObjectTranslator translator;
+        internal ObjectTranslator translator;
+
+        // 重载选择缓存的命中与未命中次数（未命中包括不能缓存的调用），用来评估命中率
+        public long OverloadCacheHits = 0;
+        public long OverloadCacheMisses = 0;
         ObjectCheckers objCheckers;
         ObjectCasters objCasters;
 
@@ -562,7 +632,7 @@ namespace XLua
                 overload.Init(objCheckers, objCasters);
                 overloads.Add(overload);
             }
-            return new MethodWrap(methodName, overloads, forceCheck);
+            return new MethodWrap(this, methodName, overloads, forceCheck);
         }
 
         private static bool tryMakeGenericMethod(ref MethodBase method)
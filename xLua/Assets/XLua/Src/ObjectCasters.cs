@@ -394,7 +394,7 @@ namespace XLua
                 return null;
             }
             LuaAPI.lua_pushvalue(L, idx);
-            return new LuaTable(LuaAPI.luaL_ref(L), translator.luaEnv);
+            return new LuaTable(LuaAPI.xlua_ref(L), translator.luaEnv);
         }
 
         private object getLuaFunction(RealStatePtr L, int idx, object target)
@@ -409,7 +409,7 @@ namespace XLua
                 return null;
             }
             LuaAPI.lua_pushvalue(L, idx);
-            return new LuaFunction(LuaAPI.luaL_ref(L), translator.luaEnv);
+            return new LuaFunction(LuaAPI.xlua_ref(L), translator.luaEnv);
         }
 
         public void AddCaster(Type type, ObjectCast oc)
@@ -22,6 +22,7 @@ namespace XLua
     using System;
     using System.Collections;
     using System.Reflection;
+    using System.Runtime.InteropServices;
     using System.Collections.Generic;
     using System.Diagnostics;
     using System.Linq;
@@ -111,6 +112,26 @@ namespace XLua
         // push到lua虚拟栈的对象的缓存池
         internal readonly ObjectPool objects = new ObjectPool();
         internal readonly Dictionary<object, int> reverseMap = new Dictionary<object, int>(new ReferenceEqualsComparer());
+
+        // 基元类型数组的元素类型，取值同 xlua.c 的 T_INT8 ~ T_DOUBLE、T_BOOL
+        static readonly Dictionary<Type, int> nativeArrayTypes = new Dictionary<Type, int>()
+        {
+            { typeof(sbyte[]), 0 },
+            { typeof(byte[]), 1 },
+            { typeof(short[]), 2 },
+            { typeof(ushort[]), 3 },
+            { typeof(char[]), 3 },
+            { typeof(int[]), 4 },
+            { typeof(uint[]), 5 },
+            { typeof(long[]), 6 },
+            { typeof(ulong[]), 7 },
+            { typeof(float[]), 8 },
+            { typeof(double[]), 9 },
+            { typeof(bool[]), 10 },
+        };
+
+        // push到lua的基元类型数组在代理存活期间保持固定，key为对象索引
+        readonly Dictionary<int, GCHandle> pinnedArrays = new Dictionary<int, GCHandle>();
 		internal LuaEnv luaEnv;
 		internal StaticLuaCallbacks metaFunctions;
 		internal List<Assembly> assemblies;
@@ -512,7 +533,7 @@ namespace XLua
             }
 
             LuaAPI.lua_pushvalue(L, idx);
-            int reference = LuaAPI.luaL_ref(L);
+            int reference = LuaAPI.xlua_ref(L);
             LuaAPI.lua_pushvalue(L, idx);
             LuaAPI.lua_pushnumber(L, reference);
             LuaAPI.lua_rawset(L, LuaIndexes.LUA_REGISTRYINDEX);  // 注册表[idx值] = reference
@@ -535,8 +556,7 @@ namespace XLua
                 LuaAPI.lua_pushvalue(L, idx);
                 LuaAPI.lua_pushnil(L);
                 LuaAPI.lua_rawset(L, LuaIndexes.LUA_REGISTRYINDEX);
-                LuaAPI.lua_pushnil(L);
-                LuaAPI.xlua_rawseti(L, LuaIndexes.LUA_REGISTRYINDEX, reference);
+                LuaAPI.lua_unref(L, reference);
                 throw e;
             }
             if (delegateType == null)
@@ -576,7 +596,7 @@ namespace XLua
         {
             if(is_delegate)
             {
-                LuaAPI.xlua_rawgeti(L, LuaIndexes.LUA_REGISTRYINDEX, reference);
+                LuaAPI.lua_getref(L, reference);
                 if (LuaAPI.lua_isnil(L, -1))
                 {
                     LuaAPI.lua_pop(L, 1);
@@ -625,7 +645,7 @@ namespace XLua
 #endif
             }
             LuaAPI.lua_pushvalue(L, idx);
-            return creator(LuaAPI.luaL_ref(L), luaEnv);
+            return creator(LuaAPI.xlua_ref(L), luaEnv);
         }
 
         int common_array_meta = -1;
@@ -633,6 +653,12 @@ namespace XLua
         {
             Utils.BeginObjectRegister(null, L, this, 0, 0, 1, 0, common_array_meta);
             Utils.RegisterFunc(L, Utils.GETTER_IDX, "Length", StaticLuaCallbacks.ArrayLength);
+            int getter_idx = LuaAPI.lua_gettop(L) + 1 + Utils.GETTER_IDX;
+            LuaAPI.xlua_pushasciistring(L, "Length");
+            LuaAPI.lua_pushvalue(L, -1);
+            LuaAPI.lua_rawget(L, getter_idx);
+            LuaAPI.gen_array_length(L);
+            LuaAPI.lua_rawset(L, getter_idx);
             Utils.EndObjectRegister(null, L, this, null, null,
                  typeof(System.Array), StaticLuaCallbacks.ArrayIndexer, StaticLuaCallbacks.ArrayNewIndexer);
         }
@@ -805,6 +831,7 @@ namespace XLua
 			if (objects.TryGetValue(obj_index_to_collect, out o))
 			{
 				objects.Remove(obj_index_to_collect);
+                unpinArray(obj_index_to_collect);
                 
                 if (o != null)
                 {
@@ -1023,6 +1050,14 @@ namespace XLua
         //only store the type id to type map for struct
         Dictionary<int, Type> typeMap = new Dictionary<int, Type>();
 
+        // 多个类型共用一张元表（如Alias）时，元表[1]只能记下其中一个type_id，这些id无法确定对象的实际类型
+        HashSet<int> sharedTypeIds = new HashSet<int>();
+
+        internal bool IsSharedTypeId(int type_id)
+        {
+            return sharedTypeIds.Contains(type_id);
+        }
+
         public int GetTypeId(RealStatePtr L, Type type)
         {
             bool isFirst;
@@ -1101,11 +1136,22 @@ namespace XLua
                     if (typeof(IEnumerable).IsAssignableFrom(type))
                     {
                         LuaAPI.xlua_pushasciistring(L, "__pairs");
-                        LuaAPI.lua_getref(L, enumerable_pairs_func);
+                        LuaAPI.xlua_rawgeti(L, LuaIndexes.LUA_REGISTRYINDEX, enumerable_pairs_func);
                         LuaAPI.lua_rawset(L, -3);
                     }
+                    LuaAPI.xlua_rawgeti(L, -1, 1);
+                    bool shared = LuaAPI.lua_type(L, -1) == LuaTypes.LUA_TNUMBER;  // 元表已被别的类型注册过
+                    if (shared)
+                    {
+                        sharedTypeIds.Add(LuaAPI.xlua_tointeger(L, -1));
+                    }
+                    LuaAPI.lua_pop(L, 1);
                     LuaAPI.lua_pushvalue(L, -1);
                     type_id = LuaAPI.luaL_ref(L, LuaIndexes.LUA_REGISTRYINDEX);  // 将元表添加到注册表中
+                    if (shared)
+                    {
+                        sharedTypeIds.Add(type_id);
+                    }
                     LuaAPI.lua_pushnumber(L, type_id);
                     LuaAPI.xlua_rawseti(L, -2, 1);   // 元表[1] = type_id
                     LuaAPI.lua_pop(L, 1);
@@ -1309,7 +1355,37 @@ namespace XLua
             // C#侧进行缓存
             index = addObject(o, is_valuetype, is_enum);
             // 将代表对象的索引push到lua，函数调用完成后栈顶是 CS对象对应的lua代理userdata
-            LuaAPI.xlua_pushcsobj(L, index, type_id, needcache, cacheRef);
+            int elem_type;
+            if (type.IsArray && nativeArrayTypes.TryGetValue(type, out elem_type))
+            {
+                GCHandle handle = GCHandle.Alloc(o, GCHandleType.Pinned);
+                pinnedArrays[index] = handle;
+                LuaAPI.xlua_pusharray(L, index, type_id, needcache, cacheRef, handle.AddrOfPinnedObject(), elem_type, ((Array)o).Length);
+            }
+            else
+            {
+                LuaAPI.xlua_pushcsobj(L, index, type_id, needcache, cacheRef);
+            }
+        }
+
+        void unpinArray(int index)
+        {
+            GCHandle handle;
+            if (pinnedArrays.TryGetValue(index, out handle))
+            {
+                pinnedArrays.Remove(index);
+                handle.Free();
+            }
+        }
+
+        // LuaEnv 关闭后 __gc 已找不到 translator，在这里统一解除固定
+        internal void ReleasePinnedArrays()
+        {
+            foreach (var handle in pinnedArrays.Values)
+            {
+                handle.Free();
+            }
+            pinnedArrays.Clear();
         }
 
         public void PushObject(RealStatePtr L, object o, int type_id)
@@ -1408,11 +1484,24 @@ namespace XLua
             return getCsObj(L, index, LuaAPI.xlua_tocsobj_fast(L,index));
         }
 
+        internal void ObjectDestroyed(RealStatePtr L, object obj)
+        {
+            int index;
+            if (obj != null && reverseMap.TryGetValue(obj, out index))
+            {
+                reverseMap.Remove(obj);
+                objects.Replace(index, null);
+                LuaAPI.xlua_markdestroyed(L, index, cacheRef);
+            }
+        }
+
         internal void ReleaseCSObj(RealStatePtr L, int index)
         {
             int udata = LuaAPI.xlua_tocsobj_safe(L, index);
             if (udata != -1)
             {
+                LuaAPI.xlua_releasearray(L, index);
+                unpinArray(udata);
                 object o = objects.Replace(udata, null);
                 if (o != null && reverseMap.ContainsKey(o))
                 {
@@ -24,8 +24,20 @@ namespace XLua
 	public class ObjectTranslatorPool
 	{
 #if !SINGLE_ENV
-        private Dictionary<RealStatePtr, WeakReference> translators = new Dictionary<RealStatePtr, WeakReference>();
-        RealStatePtr lastPtr = default(RealStatePtr);
+        // 每个状态机对应一个Entry，id同时写入native的HandleTable，回调时可直接由L读出
+        class Entry
+        {
+            public RealStatePtr ptr;
+            public int id;
+            public WeakReference translator;
+        }
+
+        // 以下三个字段只在Add/Remove里整体替换（写时复制），Find读到的总是一份完整的快照，所以不用加锁
+        volatile Entry[] entries = new Entry[1]; // 按id索引，0不用
+        volatile Dictionary<RealStatePtr, Entry> translators = new Dictionary<RealStatePtr, Entry>();
+        volatile Entry last = null;
+        // native不支持直接读id时（如lua5.1/luajit），退回到按xlua_gl查表
+        bool directId = false;
 #endif
         ObjectTranslator lastTranslator = default(ObjectTranslator);
 
@@ -57,33 +69,51 @@ namespace XLua
                 lastTranslator = translator;
 #if !SINGLE_ENV
                 var ptr = LuaAPI.xlua_gl(L);
-                lastPtr = ptr;
-                translators.Add(ptr , new WeakReference(translator));
+                var oldEntries = entries;
+                int id = 1;
+                while (id < oldEntries.Length && oldEntries[id] != null) id++;
+                var newEntries = new Entry[Math.Max(oldEntries.Length, id + 1)];
+                Array.Copy(oldEntries, newEntries, oldEntries.Length);
+                var entry = new Entry { ptr = ptr, id = id, translator = new WeakReference(translator) };
+                newEntries[id] = entry;
+                var newTranslators = new Dictionary<RealStatePtr, Entry>(translators);
+                newTranslators.Add(ptr, entry);
+
+                directId = LuaAPI.xlua_settranslator(L, id) != 0;
+                entries = newEntries;
+                translators = newTranslators;
+                last = entry;
 #endif
             }
         }
 
 		public ObjectTranslator Find (RealStatePtr L)
 		{
-#if THREAD_SAFE || HOTFIX_ENABLE
-            lock (this)
-#endif
-            {
 #if SINGLE_ENV
-                return lastTranslator;
+            return lastTranslator;
 #else
+            Entry entry;
+            if (directId)
+            {
+                var snapshot = entries;
+                int id = LuaAPI.xlua_gettranslator(L);
+                entry = id < snapshot.Length ? snapshot[id] : null;
+            }
+            else
+            {
                 var ptr = LuaAPI.xlua_gl(L);
-                if (lastPtr == ptr) return lastTranslator;
-                if (translators.ContainsKey(ptr))
+                entry = last;
+                if (entry == null || entry.ptr != ptr)
                 {
-                    lastPtr = ptr;
-                    lastTranslator = translators[ptr].Target as ObjectTranslator;
-                    return lastTranslator;
+                    if (!translators.TryGetValue(ptr, out entry))
+                    {
+                        return null;
+                    }
+                    last = entry;
                 }
-                
-                return null;
-#endif
             }
+            return entry == null ? null : entry.translator.Target as ObjectTranslator;
+#endif
         }
 		
 		public void Remove (RealStatePtr L)
@@ -96,16 +126,21 @@ namespace XLua
                 lastTranslator = default(ObjectTranslator);
 #else
                 var ptr = LuaAPI.xlua_gl(L);
-                if (!translators.ContainsKey (ptr))
+                Entry entry;
+                if (!translators.TryGetValue(ptr, out entry))
                     return;
-                
-                if (lastPtr == ptr)
+
+                var newEntries = (Entry[])entries.Clone();
+                newEntries[entry.id] = null;
+                var newTranslators = new Dictionary<RealStatePtr, Entry>(translators);
+                newTranslators.Remove(ptr);
+
+                entries = newEntries;
+                translators = newTranslators;
+                if (last == entry)
                 {
-                    lastPtr = default(RealStatePtr);
-                    lastTranslator = default(ObjectTranslator);
+                    last = null;
                 }
-
-                translators.Remove(ptr);
 #endif
             }
         }
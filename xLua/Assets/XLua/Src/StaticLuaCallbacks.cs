@@ -1001,7 +1001,14 @@ namespace XLua
                     var field = type.GetField(fieldName, bindingFlags);
                     if (field != null)
                     {
-                        field.SetValue(obj, translator.GetObject(L, 3, field.FieldType));
+                        if (field.IsStatic && fieldName.Contains("__Hotfix"))
+                        {
+                            HotfixDelegateBridge.SetPatchField(field, translator.GetObject(L, 3, field.FieldType));
+                        }
+                        else
+                        {
+                            field.SetValue(obj, translator.GetObject(L, 3, field.FieldType));
+                        }
                         return 0;
                     }
                     var prop = type.GetProperty(fieldName, bindingFlags);
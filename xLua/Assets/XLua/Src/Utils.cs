@@ -602,6 +602,21 @@ namespace XLua
 			}
 		}
 
+		static void clearUpvalue(RealStatePtr L, Type type, string metafunc, int index)
+		{
+			ObjectTranslator translator = ObjectTranslatorPool.Instance.Find(L);
+			LuaAPI.xlua_pushasciistring(L, metafunc);
+			LuaAPI.lua_rawget(L, LuaIndexes.LUA_REGISTRYINDEX);
+			translator.Push(L, type);
+			LuaAPI.lua_rawget(L, -2);
+			LuaAPI.lua_pushnil(L);
+			if (LuaAPI.lua_setupvalue(L, -2, index) == IntPtr.Zero)  // 没有这个upvalue时nil不会被弹出
+			{
+				LuaAPI.lua_pop(L, 1);
+			}
+			LuaAPI.lua_pop(L, 2);
+		}
+
 		public static void loadUpvalue(RealStatePtr L, Type type, string metafunc, int index)
 		{
 			ObjectTranslator translator = ObjectTranslatorPool.Instance.Find(L);
@@ -679,6 +694,10 @@ namespace XLua
 				out item_getter, out item_setter, BindingFlags.NonPublic);
 			LuaAPI.lua_settop(L, oldTop);
 
+			// 上面改动了成员表，生成代码的成员索引可能和表不一致，去掉它
+			clearUpvalue(L, type, LuaIndexsFieldName, 8);
+			clearUpvalue(L, type, LuaNewIndexsFieldName, 7);
+
 			foreach (var nested_type in type.GetNestedTypes(BindingFlags.NonPublic))
 			{
 				if ((!nested_type.IsAbstract() && typeof(Delegate).IsAssignableFrom(nested_type))
@@ -1078,13 +1097,14 @@ namespace XLua
 
 		/// <summary>
 		/// 结束类非静态域的注册
+		/// memberNames由生成代码传入，是已注册的成员方法、getter、setter的名字，用来建native的成员索引
 		/// </summary>
 #if GEN_CODE_MINIMIZE
         public static void EndObjectRegister(Type type, RealStatePtr L, ObjectTranslator translator, CSharpWrapper csIndexer,
-            CSharpWrapper csNewIndexer, Type base_type, CSharpWrapper arrayIndexer, CSharpWrapper arrayNewIndexer)
+            CSharpWrapper csNewIndexer, Type base_type, CSharpWrapper arrayIndexer, CSharpWrapper arrayNewIndexer, string[] memberNames = null)
 #else
 		public static void EndObjectRegister(Type type, RealStatePtr L, ObjectTranslator translator, LuaCSFunction csIndexer,
-			LuaCSFunction csNewIndexer, Type base_type, LuaCSFunction arrayIndexer, LuaCSFunction arrayNewIndexer)
+			LuaCSFunction csNewIndexer, Type base_type, LuaCSFunction arrayIndexer, LuaCSFunction arrayNewIndexer, string[] memberNames = null)
 #endif
 		{
 			int top = LuaAPI.lua_gettop(L);
@@ -1093,6 +1113,13 @@ namespace XLua
 			int getter_idx = abs_idx(top, GETTER_IDX);
 			int setter_idx = abs_idx(top, SETTER_IDX);
 
+			int member_index_idx = 0;
+			if (memberNames != null && memberNames.Length > 0)
+			{
+				LuaAPI.xlua_pushmemberindex(L, method_idx, getter_idx, setter_idx, memberNames, memberNames.Length);
+				member_index_idx = top + 1;  // top + 2 是存放函数的表
+			}
+
 			//begin index gen
 			LuaAPI.xlua_pushasciistring(L, "__index");
 			LuaAPI.lua_pushvalue(L, method_idx);
@@ -1128,7 +1155,16 @@ namespace XLua
 #endif
 			}
 
-			LuaAPI.gen_obj_indexer(L);
+			if (member_index_idx != 0)
+			{
+				LuaAPI.lua_pushvalue(L, member_index_idx);
+				LuaAPI.lua_pushvalue(L, member_index_idx + 1);
+				LuaAPI.gen_obj_indexer_indexed(L);
+			}
+			else
+			{
+				LuaAPI.gen_obj_indexer(L);
+			}
 
 			if (type != null)
 			{
@@ -1178,7 +1214,16 @@ namespace XLua
 #endif
 			}
 
-			LuaAPI.gen_obj_newindexer(L);
+			if (member_index_idx != 0)
+			{
+				LuaAPI.lua_pushvalue(L, member_index_idx);
+				LuaAPI.lua_pushvalue(L, member_index_idx + 1);
+				LuaAPI.gen_obj_newindexer_indexed(L);
+			}
+			else
+			{
+				LuaAPI.gen_obj_newindexer(L);
+			}
 
 			if (type != null)
 			{
@@ -1192,7 +1237,7 @@ namespace XLua
 
 			LuaAPI.lua_rawset(L, meta_idx);
 			//end new index gen
-			LuaAPI.lua_pop(L, 4);
+			LuaAPI.lua_settop(L, top - 4);
 		}
 
 #if GEN_CODE_MINIMIZE
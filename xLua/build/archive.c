@@ -0,0 +1,463 @@
+/*
+ *Tencent is pleased to support the open source community by making xLua available.
+ *Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+ *Licensed under the MIT License (the "License"); you may not use this file except in compliance with the License. You may obtain a copy of the License at
+ *http://opensource.org/licenses/MIT
+ *Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the License for the specific language governing permissions and limitations under the License.
+*/
+
+#define LUA_LIB
+
+#include "archive.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/*
+** Packed script archive.
+**
+** The whole archive is read with one sequential read (or handed over as a
+** buffer) and modules are loaded straight from it with luaL_loadbuffer, so
+** requiring a script costs a binary search instead of a file open. The
+** writer below is shared with the xluapack tool (built with XLUA_PACKER).
+*/
+
+static uint32_t get32(const unsigned char *p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put32(unsigned char *p, uint32_t v) {
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+}
+
+/* LZ4 block format, see https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md */
+
+#define LZ4_MINMATCH	4
+#define LZ4_LASTLITERALS	5
+#define LZ4_MFLIMIT	12
+#define LZ4_HASH_BITS	12
+#define LZ4_MAX_OFFSET	65535
+
+static size_t lz4_bound(size_t n) {
+	return n + n / 255 + 16;
+}
+
+static unsigned char *lz4_putlen(unsigned char *op, size_t len) {
+	for (; len >= 255; len -= 255) {
+		*op++ = 255;
+	}
+	*op++ = (unsigned char)len;
+	return op;
+}
+
+static unsigned char *lz4_sequence(unsigned char *op, const unsigned char *lit, size_t litlen,
+		size_t off, size_t matchlen) {
+	unsigned char *token = op++;
+	*token = (unsigned char)((litlen >= 15 ? 15 : litlen) << 4);
+	if (litlen >= 15) op = lz4_putlen(op, litlen - 15);
+	memcpy(op, lit, litlen);
+	op += litlen;
+	if (matchlen > 0) {
+		matchlen -= LZ4_MINMATCH;
+		*token |= (unsigned char)(matchlen >= 15 ? 15 : matchlen);
+		*op++ = (unsigned char)off;
+		*op++ = (unsigned char)(off >> 8);
+		if (matchlen >= 15) op = lz4_putlen(op, matchlen - 15);
+	}
+	return op;
+}
+
+/* greedy single-probe compressor, dst must hold lz4_bound(n) bytes */
+static size_t lz4_compress(const unsigned char *src, size_t n, unsigned char *dst) {
+	uint32_t table[1 << LZ4_HASH_BITS];
+	const unsigned char *ip = src, *anchor = src, *iend = src + n;
+	const unsigned char *mflimit = n > LZ4_MFLIMIT ? iend - LZ4_MFLIMIT : src;
+	unsigned char *op = dst;
+	memset(table, 0, sizeof(table));
+	while (ip < mflimit) {
+		uint32_t seq = get32(ip);
+		uint32_t h = (seq * 2654435761u) >> (32 - LZ4_HASH_BITS);
+		const unsigned char *ref = src + table[h];
+		table[h] = (uint32_t)(ip - src);
+		if (ref < ip && ip - ref <= LZ4_MAX_OFFSET && get32(ref) == seq) {
+			const unsigned char *p = ip + LZ4_MINMATCH, *q = ref + LZ4_MINMATCH;
+			while (p < iend - LZ4_LASTLITERALS && *p == *q) {
+				p++;
+				q++;
+			}
+			op = lz4_sequence(op, anchor, ip - anchor, ip - ref, p - ip);
+			ip = anchor = p;
+		} else {
+			ip++;
+		}
+	}
+	op = lz4_sequence(op, anchor, iend - anchor, 0, 0);
+	return op - dst;
+}
+
+static int compare_name(const char *a, size_t alen, const char *b, size_t blen) {
+	int c = memcmp(a, b, alen < blen ? alen : blen);
+	if (c != 0) return c;
+	return alen < blen ? -1 : (alen > blen ? 1 : 0);
+}
+
+static int compare_file(const void *a, const void *b) {
+	const XArchiveFile *fa = (const XArchiveFile *)a;
+	const XArchiveFile *fb = (const XArchiveFile *)b;
+	return compare_name(fa->name, fa->name_len, fb->name, fb->name_len);
+}
+
+int xarchive_write(FILE *f, XArchiveFile *files, int count, int compress) {
+	unsigned char *head;
+	unsigned char **zdata;  /* compressed chunks, NULL where stored as is */
+	size_t names_off, names_size = 0, head_size, data_off;
+	int i, ret = -1;
+
+	qsort(files, count, sizeof(XArchiveFile), compare_file);
+	for (i = 0; i < count; i++) {
+		if (i > 0 && compare_file(&files[i - 1], &files[i]) == 0) return -1;  /* duplicated name */
+		names_size += files[i].name_len;
+	}
+	names_off = XAR_HEADER_SIZE + (size_t)count * XAR_ENTRY_SIZE;
+	head_size = names_off + names_size;
+	head = (unsigned char *)malloc(head_size);
+	zdata = (unsigned char **)calloc(count > 0 ? count : 1, sizeof(unsigned char *));
+	if (head == NULL || zdata == NULL) goto done;
+
+	memcpy(head, XAR_MAGIC, 4);
+	put32(head + 4, XAR_VERSION);
+	put32(head + 8, (uint32_t)count);
+	put32(head + 12, (uint32_t)names_size);
+	data_off = head_size;
+	for (i = 0; i < count; i++) {
+		unsigned char *e = head + XAR_HEADER_SIZE + (size_t)i * XAR_ENTRY_SIZE;
+		size_t size = files[i].size;
+		if (compress) {
+			unsigned char *z = (unsigned char *)malloc(lz4_bound(size));
+			size_t zsize;
+			if (z == NULL) goto done;
+			zsize = lz4_compress(files[i].data, size, z);
+			if (zsize < size) {  /* keep it only when it pays off */
+				zdata[i] = z;
+				size = zsize;
+			} else {
+				free(z);
+			}
+		}
+		memcpy(head + names_off, files[i].name, files[i].name_len);
+		put32(e, (uint32_t)names_off);
+		put32(e + 4, (uint32_t)files[i].name_len);
+		put32(e + 8, (uint32_t)data_off);
+		put32(e + 12, (uint32_t)size);
+		put32(e + 16, (uint32_t)files[i].size);
+		put32(e + 20, zdata[i] != NULL ? XAR_LZ4 : 0);
+		names_off += files[i].name_len;
+		data_off += size;
+	}
+	if (fwrite(head, 1, head_size, f) != head_size) goto done;
+	for (i = 0; i < count; i++) {
+		size_t size = get32(head + XAR_HEADER_SIZE + (size_t)i * XAR_ENTRY_SIZE + 12);
+		if (fwrite(zdata[i] != NULL ? zdata[i] : files[i].data, 1, size, f) != size) goto done;
+	}
+	ret = 0;
+done:
+	if (zdata != NULL) {
+		for (i = 0; i < count; i++) {
+			free(zdata[i]);
+		}
+	}
+	free(zdata);
+	free(head);
+	return ret;
+}
+
+#ifndef XLUA_PACKER
+
+#define ARCHIVE_META	"xlua.archive"
+
+typedef struct {
+	unsigned char *buf;
+	size_t size;
+	uint32_t count;
+} Archive;
+
+static const unsigned char *get_entry(const Archive *a, uint32_t i) {
+	return a->buf + XAR_HEADER_SIZE + (size_t)i * XAR_ENTRY_SIZE;
+}
+
+/* checks every range once so lookups can trust the archive */
+static int validate(const unsigned char *buf, size_t size, uint32_t *count) {
+	uint32_t i, n;
+	size_t head_size;
+	if (size < XAR_HEADER_SIZE || memcmp(buf, XAR_MAGIC, 4) != 0) return 0;
+	if (get32(buf + 4) != XAR_VERSION) return 0;
+	n = get32(buf + 8);
+	if (n > (size - XAR_HEADER_SIZE) / XAR_ENTRY_SIZE) return 0;
+	head_size = XAR_HEADER_SIZE + (size_t)n * XAR_ENTRY_SIZE;
+	if (get32(buf + 12) > size - head_size) return 0;
+	head_size += get32(buf + 12);
+	for (i = 0; i < n; i++) {
+		const unsigned char *e = buf + XAR_HEADER_SIZE + (size_t)i * XAR_ENTRY_SIZE;
+		uint32_t name_off = get32(e), name_len = get32(e + 4);
+		uint32_t data_off = get32(e + 8), data_size = get32(e + 12);
+		if (name_off > head_size || name_len > head_size - name_off) return 0;
+		if (data_off > size || data_size > size - data_off) return 0;
+		if (!(get32(e + 20) & XAR_LZ4) && data_size != get32(e + 16)) return 0;
+	}
+	*count = n;
+	return 1;
+}
+
+static const unsigned char *find_entry(const Archive *a, const char *name, size_t len) {
+	uint32_t lo = 0, hi = a->count;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		const unsigned char *e = get_entry(a, mid);
+		int c = compare_name((const char *)a->buf + get32(e), get32(e + 4), name, len);
+		if (c == 0) return e;
+		if (c < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return NULL;
+}
+
+static int lz4_getlen(const unsigned char **ip, const unsigned char *iend, size_t *len) {
+	unsigned b;
+	do {
+		if (*ip >= iend) return 0;
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+	return 1;
+}
+
+/* returns 1 when src decodes to exactly dstlen bytes */
+static int lz4_decompress(const unsigned char *src, size_t srclen, unsigned char *dst, size_t dstlen) {
+	const unsigned char *ip = src, *iend = src + srclen;
+	unsigned char *op = dst, *oend = dst + dstlen;
+	while (ip < iend) {
+		unsigned token = *ip++;
+		size_t len = token >> 4, off;
+		const unsigned char *match;
+		if (len == 15 && !lz4_getlen(&ip, iend, &len)) return 0;
+		if (len > (size_t)(iend - ip) || len > (size_t)(oend - op)) return 0;
+		memcpy(op, ip, len);
+		op += len;
+		ip += len;
+		if (ip == iend) break;  /* the last sequence has no match */
+		if (iend - ip < 2) return 0;
+		off = ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		if (off == 0 || off > (size_t)(op - dst)) return 0;
+		len = token & 15;
+		if (len == 15 && !lz4_getlen(&ip, iend, &len)) return 0;
+		len += LZ4_MINMATCH;
+		if (len > (size_t)(oend - op)) return 0;
+		for (match = op - off; len > 0; len--) {  /* may overlap */
+			*op++ = *match++;
+		}
+	}
+	return op == oend;
+}
+
+/* pushes the loaded chunk, or nil and a message */
+static int load_entry(lua_State *L, const Archive *a, const unsigned char *e, const char *name) {
+	const char *data = (const char *)a->buf + get32(e + 8);
+	size_t size = get32(e + 12);
+	int status;
+	if (get32(e + 20) & XAR_LZ4) {
+		unsigned char *raw = (unsigned char *)lua_newuserdata(L, get32(e + 16));
+		if (!lz4_decompress((const unsigned char *)data, size, raw, get32(e + 16))) {
+			lua_pushnil(L);
+			lua_pushfstring(L, "corrupted chunk '%s' in archive", name);
+			return 2;
+		}
+		data = (const char *)raw;
+		size = get32(e + 16);
+	}
+	lua_pushfstring(L, "@%s", name);
+	status = luaL_loadbuffer(L, data, size, lua_tostring(L, -1));
+	if (status != 0) {
+		lua_pushnil(L);
+		lua_insert(L, -2);
+		return 2;
+	}
+	return 1;
+}
+
+static Archive *check_archive(lua_State *L) {
+	Archive *a = (Archive *)luaL_checkudata(L, 1, ARCHIVE_META);
+	if (a->buf == NULL) luaL_error(L, "archive is closed");
+	return a;
+}
+
+/* takes ownership of buf, allocated with the state allocator */
+static int push_archive(lua_State *L, unsigned char *buf, size_t size) {
+	void *ud;
+	lua_Alloc allocf = lua_getallocf(L, &ud);
+	Archive *a;
+	uint32_t count;
+	if (!validate(buf, size, &count)) {
+		allocf(ud, buf, size, 0);
+		lua_pushnil(L);
+		lua_pushliteral(L, "not a valid script archive");
+		return 2;
+	}
+	a = (Archive *)lua_newuserdata(L, sizeof(Archive));
+	a->buf = buf;
+	a->size = size;
+	a->count = count;
+	luaL_getmetatable(L, ARCHIVE_META);
+	lua_setmetatable(L, -2);
+	return 1;
+}
+
+static int archive_open(lua_State *L) {
+	const char *path = luaL_checkstring(L, 1);
+	void *ud;
+	lua_Alloc allocf = lua_getallocf(L, &ud);
+	unsigned char *buf;
+	long size;
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) {
+		lua_pushnil(L);
+		lua_pushfstring(L, "cannot open %s", path);
+		return 2;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	buf = size > 0 ? (unsigned char *)allocf(ud, NULL, 0, (size_t)size) : NULL;
+	if (buf == NULL || fread(buf, 1, (size_t)size, f) != (size_t)size) {
+		if (buf != NULL) allocf(ud, buf, (size_t)size, 0);
+		fclose(f);
+		lua_pushnil(L);
+		lua_pushfstring(L, "cannot read %s", path);
+		return 2;
+	}
+	fclose(f);
+	return push_archive(L, buf, (size_t)size);
+}
+
+static int archive_frombuffer(lua_State *L) {
+	size_t size;
+	const char *s = luaL_checklstring(L, 1, &size);
+	void *ud;
+	lua_Alloc allocf = lua_getallocf(L, &ud);
+	unsigned char *buf = (unsigned char *)allocf(ud, NULL, 0, size > 0 ? size : 1);
+	if (buf == NULL) return luaL_error(L, "not enough memory");
+	memcpy(buf, s, size);
+	return push_archive(L, buf, size);
+}
+
+static int archive_load(lua_State *L) {
+	Archive *a = check_archive(L);
+	size_t len;
+	const char *name = luaL_checklstring(L, 2, &len);
+	const unsigned char *e = find_entry(a, name, len);
+	if (e == NULL) {
+		lua_pushnil(L);
+		lua_pushfstring(L, "no file '%s' in archive", name);
+		return 2;
+	}
+	return load_entry(L, a, e, name);
+}
+
+static int archive_has(lua_State *L) {
+	Archive *a = check_archive(L);
+	size_t len;
+	const char *name = luaL_checklstring(L, 2, &len);
+	lua_pushboolean(L, find_entry(a, name, len) != NULL);
+	return 1;
+}
+
+static int archive_names(lua_State *L) {
+	Archive *a = check_archive(L);
+	uint32_t i;
+	lua_createtable(L, (int)a->count, 0);
+	for (i = 0; i < a->count; i++) {
+		const unsigned char *e = get_entry(a, i);
+		lua_pushlstring(L, (const char *)a->buf + get32(e), get32(e + 4));
+		lua_rawseti(L, -2, (int)i + 1);
+	}
+	return 1;
+}
+
+/* package.loaders / package.searchers entry: raises on a broken chunk like the file searchers */
+static int archive_search(lua_State *L) {
+	size_t len;
+	const char *name = luaL_checklstring(L, 1, &len);
+	Archive *a = (Archive *)lua_touserdata(L, lua_upvalueindex(1));
+	const unsigned char *e = a->buf != NULL ? find_entry(a, name, len) : NULL;
+	if (e == NULL) {
+		lua_pushfstring(L, "\n\tno file '%s' in archive", name);
+		return 1;
+	}
+	if (load_entry(L, a, e, name) != 1) {
+		return luaL_error(L, "error loading module '%s' from archive:\n\t%s", name, lua_tostring(L, -1));
+	}
+	return 1;
+}
+
+static int archive_searcher(lua_State *L) {
+	check_archive(L);
+	lua_settop(L, 1);
+	lua_pushcclosure(L, archive_search, 1);
+	return 1;
+}
+
+static int archive_close(lua_State *L) {
+	Archive *a = (Archive *)luaL_checkudata(L, 1, ARCHIVE_META);
+	if (a->buf != NULL) {
+		void *ud;
+		lua_Alloc allocf = lua_getallocf(L, &ud);
+		allocf(ud, a->buf, a->size, 0);
+		a->buf = NULL;
+	}
+	return 0;
+}
+
+static const luaL_Reg archive_methods[] = {
+	{"load", archive_load},
+	{"has", archive_has},
+	{"names", archive_names},
+	{"searcher", archive_searcher},
+	{"close", archive_close},
+	{NULL, NULL}
+};
+
+static const luaL_Reg archivelib[] = {
+	{"open", archive_open},
+	{"frombuffer", archive_frombuffer},
+	{NULL, NULL}
+};
+
+LUALIB_API int luaopen_archive(lua_State* L) {
+	const luaL_Reg *l;
+
+	luaL_newmetatable(L, ARCHIVE_META);
+	lua_pushcfunction(L, archive_close);
+	lua_setfield(L, -2, "__gc");
+	lua_newtable(L);
+	for (l = archive_methods; l->name != NULL; l++) {
+		lua_pushcfunction(L, l->func);
+		lua_setfield(L, -2, l->name);
+	}
+	lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
+
+	lua_newtable(L);
+	for (l = archivelib; l->name != NULL; l++) {
+		lua_pushcfunction(L, l->func);
+		lua_setfield(L, -2, l->name);
+	}
+	return 1;
+}
+
+#endif
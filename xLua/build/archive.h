@@ -0,0 +1,66 @@
+/*
+ *Tencent is pleased to support the open source community by making xLua available.
+ *Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+ *Licensed under the MIT License (the "License"); you may not use this file except in compliance with the License. You may obtain a copy of the License at
+ *http://opensource.org/licenses/MIT
+ *Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the License for the specific language governing permissions and limitations under the License.
+*/
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#ifndef XLUA_PACKER
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+#endif
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C"{
+#endif
+#endif /* __cplusplus */
+
+/*
+** Script archive layout, all integers are little-endian uint32:
+**
+**   header   "XLAR" version count names_size
+**   entries  count * (name_off name_len data_off data_size raw_size flags)
+**   names    names_size bytes, entries are sorted by name
+**   data     the chunks, data_off is relative to the start of the archive
+**
+** A chunk with XAR_LZ4 set holds raw_size bytes compressed in the LZ4 block
+** format, otherwise data_size == raw_size and it is stored as is.
+*/
+#define XAR_MAGIC	"XLAR"
+#define XAR_VERSION	1
+#define XAR_HEADER_SIZE	16
+#define XAR_ENTRY_SIZE	24
+
+#define XAR_LZ4	1
+
+typedef struct {
+	const char *name;
+	size_t name_len;
+	const unsigned char *data;
+	size_t size;
+} XArchiveFile;
+
+/* writes files (sorted in place by name) to f, returns 0 on success */
+int xarchive_write(FILE *f, XArchiveFile *files, int count, int compress);
+
+#ifndef XLUA_PACKER
+LUALIB_API int luaopen_archive(lua_State* L);
+#endif
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif /* __cplusplus */
+
+
+#endif
@@ -0,0 +1,403 @@
+/*
+ *Tencent is pleased to support the open source community by making xLua available.
+ *Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+ *Licensed under the MIT License (the "License"); you may not use this file except in compliance with the License. You may obtain a copy of the License at
+ *http://opensource.org/licenses/MIT
+ *Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the License for the specific language governing permissions and limitations under the License.
+*/
+
+#define LUA_LIB
+
+#include "scheduler.h"
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+/*
+** Coroutine scheduler ticked by the host.
+**
+** Parked coroutines live in a timer wheel (sleep) or in per-event wait lists
+** (wait_until). The host calls xlua_scheduler_tick once per frame with the
+** current time in milliseconds; expired timers and signalled waiters move to
+** the ready queue and are resumed there, so any number of waiting coroutines
+** costs a single native call per frame.
+**
+** A coroutine that yields with coroutine.yield() instead of a scheduler call
+** is resumed again on the next tick. Coroutines parked by the scheduler must
+** only be resumed by it.
+*/
+
+#define WHEEL_BITS	10
+#define WHEEL_SIZE	(1 << WHEEL_BITS)
+#define WHEEL_MASK	(WHEEL_SIZE - 1)
+
+#define NIL_NODE	(-1)
+
+typedef struct {
+	int64_t expire;  /* wake-up time in ms, timers only */
+	int ref;  /* reference of the thread in the anchor table */
+	int nargs;  /* values to pass on the next resume */
+	int next;
+} Waiter;
+
+typedef struct {
+	Waiter *nodes;
+	int size;
+	int free;
+	int ready_head;
+	int ready_tail;
+	int pending;  /* threads parked in the scheduler */
+	int running;  /* inside a tick */
+	int anchor_ref;  /* table keeping the parked threads alive */
+	int events_ref;  /* event -> first waiter */
+	lua_State *parked;  /* the running thread parked itself */
+	int64_t now;
+	int wheel[WHEEL_SIZE];
+} Scheduler;
+
+static int sched_key = 0;
+
+static Scheduler *get_scheduler(lua_State *L) {
+	Scheduler *s;
+	lua_pushlightuserdata(L, &sched_key);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	s = (Scheduler *)lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	return s;
+}
+
+static int new_node(lua_State *L, Scheduler *s) {
+	int n;
+	if (s->free == NIL_NODE) {
+		void *ud;
+		lua_Alloc allocf = lua_getallocf(L, &ud);
+		int size = s->size ? s->size * 2 : 64;
+		Waiter *nodes = (Waiter *)allocf(ud, s->nodes, s->size * sizeof(Waiter), size * sizeof(Waiter));
+		if (nodes == NULL) {
+			luaL_error(L, "not enough memory");
+		}
+		for (n = size - 1; n >= s->size; n--) {
+			nodes[n].next = s->free;
+			s->free = n;
+		}
+		s->nodes = nodes;
+		s->size = size;
+	}
+	n = s->free;
+	s->free = s->nodes[n].next;
+	return n;
+}
+
+/* anchors the thread on the top of the stack (popping it) in a new waiter */
+static int anchor(lua_State *L, Scheduler *s, int nargs) {
+	int n = new_node(L, s);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, s->anchor_ref);
+	lua_insert(L, -2);
+	s->nodes[n].ref = luaL_ref(L, -2);
+	lua_pop(L, 1);
+	s->nodes[n].nargs = nargs;
+	s->nodes[n].next = NIL_NODE;
+	s->pending++;
+	return n;
+}
+
+static void release(lua_State *L, Scheduler *s, int n, int anchor_idx) {
+	luaL_unref(L, anchor_idx, s->nodes[n].ref);
+	s->nodes[n].next = s->free;
+	s->free = n;
+	s->pending--;
+}
+
+static void add_timer(Scheduler *s, int n, int64_t expire) {
+	int *slot;
+	if (expire <= s->now) {
+		expire = s->now + 1;
+	}
+	slot = &s->wheel[expire & WHEEL_MASK];
+	s->nodes[n].expire = expire;
+	s->nodes[n].next = *slot;
+	*slot = n;
+}
+
+static void add_ready(Scheduler *s, int n) {
+	s->nodes[n].next = NIL_NODE;
+	if (s->ready_tail == NIL_NODE) {
+		s->ready_head = n;
+	} else {
+		s->nodes[s->ready_tail].next = n;
+	}
+	s->ready_tail = n;
+}
+
+static void advance(Scheduler *s, int64_t target) {
+	int64_t t, stop;
+	if (target <= s->now) {
+		return;
+	}
+	/* a jump longer than the wheel visits every slot once */
+	stop = (target - s->now >= WHEEL_SIZE) ? s->now + WHEEL_SIZE : target;
+	for (t = s->now + 1; t <= stop; t++) {
+		int *p = &s->wheel[t & WHEEL_MASK];
+		while (*p != NIL_NODE) {
+			int n = *p;
+			if (s->nodes[n].expire <= target) {
+				*p = s->nodes[n].next;
+				add_ready(s, n);
+			} else {
+				p = &s->nodes[n].next;
+			}
+		}
+	}
+	s->now = target;
+}
+
+static int resume(lua_State *co, lua_State *from, int nargs) {
+#if LUA_VERSION_NUM >= 504
+	int nres;
+	return lua_resume(co, from, nargs, &nres);
+#elif LUA_VERSION_NUM >= 502
+	return lua_resume(co, from, nargs);
+#else
+	(void)from;
+	return lua_resume(co, nargs);
+#endif
+}
+
+static int can_resume(lua_State *co, int nargs) {
+	lua_Debug ar;
+	switch (lua_status(co)) {
+		case LUA_YIELD:
+			return 1;
+		case 0:  /* not started yet: function and arguments only */
+			return lua_getstack(co, 0, &ar) == 0 && lua_gettop(co) == nargs + 1;
+		default:
+			return 0;
+	}
+}
+
+/*
+** Resumes the threads queued before the call; threads queued while running
+** wait for the next tick. Returns the number of resumed threads, or -1 with
+** the error object on the top of the stack.
+*/
+static int run_ready(lua_State *L, Scheduler *s) {
+	int count = 0;
+	int top = lua_gettop(L);
+	int last = s->ready_tail;
+	if (last == NIL_NODE || s->running) {
+		return 0;
+	}
+	s->running = 1;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, s->anchor_ref);
+	for (;;) {
+		int n = s->ready_head;
+		int done = (n == last);
+		int nargs = s->nodes[n].nargs;
+		int status;
+		lua_State *co;
+		s->ready_head = s->nodes[n].next;
+		if (s->ready_head == NIL_NODE) {
+			s->ready_tail = NIL_NODE;
+		}
+		s->nodes[n].nargs = 0;
+		lua_rawgeti(L, top + 1, s->nodes[n].ref);
+		co = lua_tothread(L, -1);
+		if (!can_resume(co, nargs)) {  /* resumed from elsewhere meanwhile */
+			release(L, s, n, top + 1);
+			lua_pop(L, 1);
+		} else {
+			s->parked = NULL;
+			status = resume(co, L, nargs);
+			count++;
+			if (status == LUA_YIELD) {
+				lua_settop(co, 0);
+				if (s->parked == co) {  /* waiting on a new timer or event */
+					release(L, s, n, top + 1);
+				} else {
+					add_ready(s, n);
+				}
+				lua_pop(L, 1);
+			} else if (status == 0) {
+				release(L, s, n, top + 1);
+				lua_pop(L, 1);
+			} else {
+				release(L, s, n, top + 1);
+				lua_xmove(co, L, 1);
+				lua_replace(L, top + 1);
+				lua_settop(L, top + 1);
+				s->running = 0;
+				return -1;
+			}
+		}
+		if (done) {
+			break;
+		}
+	}
+	lua_settop(L, top);
+	s->running = 0;
+	return count;
+}
+
+LUA_API int xlua_scheduler_tick(lua_State *L, double now) {
+	Scheduler *s = get_scheduler(L);
+	if (s == NULL || s->running) {
+		return 0;
+	}
+	advance(s, (int64_t)floor(now));
+	return run_ready(L, s);
+}
+
+static int sched_tick(lua_State *L) {
+	Scheduler *s = get_scheduler(L);
+	lua_Number now = luaL_checknumber(L, 1);
+	int count;
+	if (s->running) {
+		return luaL_error(L, "scheduler is already running");
+	}
+	advance(s, (int64_t)floor(now));
+	count = run_ready(L, s);
+	if (count < 0) {
+		return lua_error(L);
+	}
+	lua_pushinteger(L, count);
+	return 1;
+}
+
+static int sched_spawn(lua_State *L) {
+	Scheduler *s = get_scheduler(L);
+	int nargs = lua_gettop(L) - 1;
+	lua_State *co;
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+	co = lua_newthread(L);
+	lua_insert(L, 1);
+	lua_xmove(L, co, nargs + 1);
+	lua_pushvalue(L, 1);
+	add_ready(s, anchor(L, s, nargs));
+	return 1;
+}
+
+static int sched_sleep(lua_State *L) {
+	Scheduler *s = get_scheduler(L);
+	lua_Number ms = luaL_checknumber(L, 1);
+	int64_t expire = s->now + (ms > 0 ? (int64_t)ceil(ms) : 0);
+	if (lua_pushthread(L)) {
+		return luaL_error(L, "sleep must be called from a coroutine");
+	}
+	add_timer(s, anchor(L, s, 0), expire);
+	s->parked = L;
+	return lua_yield(L, 0);
+}
+
+static int sched_wait_until(lua_State *L) {
+	Scheduler *s = get_scheduler(L);
+	int n;
+	luaL_argcheck(L, !lua_isnoneornil(L, 1), 1, "event expected");
+	if (lua_pushthread(L)) {
+		return luaL_error(L, "wait_until must be called from a coroutine");
+	}
+	n = anchor(L, s, 0);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, s->events_ref);
+	lua_pushvalue(L, 1);
+	lua_rawget(L, -2);
+	s->nodes[n].next = lua_isnil(L, -1) ? NIL_NODE : (int)lua_tointeger(L, -1);
+	lua_pop(L, 1);
+	lua_pushvalue(L, 1);
+	lua_pushinteger(L, n);
+	lua_rawset(L, -3);
+	lua_pop(L, 1);
+	s->parked = L;
+	return lua_yield(L, 0);
+}
+
+static int sched_signal(lua_State *L) {
+	Scheduler *s = get_scheduler(L);
+	int n, prev = NIL_NODE, count = 0;
+	luaL_argcheck(L, !lua_isnoneornil(L, 1), 1, "event expected");
+	lua_rawgeti(L, LUA_REGISTRYINDEX, s->events_ref);
+	lua_pushvalue(L, 1);
+	lua_rawget(L, -2);
+	if (lua_isnil(L, -1)) {
+		lua_pushinteger(L, 0);
+		return 1;
+	}
+	n = (int)lua_tointeger(L, -1);
+	lua_pop(L, 1);
+	lua_pushvalue(L, 1);
+	lua_pushnil(L);
+	lua_rawset(L, -3);
+	while (n != NIL_NODE) {  /* waiters were pushed in front, wake the oldest first */
+		int next = s->nodes[n].next;
+		s->nodes[n].next = prev;
+		prev = n;
+		n = next;
+	}
+	for (n = prev; n != NIL_NODE; count++) {
+		int next = s->nodes[n].next;
+		add_ready(s, n);
+		n = next;
+	}
+	lua_pushinteger(L, count);
+	return 1;
+}
+
+static int sched_now(lua_State *L) {
+	lua_pushnumber(L, (lua_Number)get_scheduler(L)->now);
+	return 1;
+}
+
+static int sched_pending(lua_State *L) {
+	lua_pushinteger(L, get_scheduler(L)->pending);
+	return 1;
+}
+
+static int sched_gc(lua_State *L) {
+	Scheduler *s = (Scheduler *)lua_touserdata(L, 1);
+	void *ud;
+	lua_Alloc allocf = lua_getallocf(L, &ud);
+	allocf(ud, s->nodes, s->size * sizeof(Waiter), 0);
+	s->nodes = NULL;
+	s->size = 0;
+	return 0;
+}
+
+static const luaL_Reg schedlib[] = {
+	{"spawn", sched_spawn},
+	{"sleep", sched_sleep},
+	{"wait_until", sched_wait_until},
+	{"signal", sched_signal},
+	{"tick", sched_tick},
+	{"now", sched_now},
+	{"pending", sched_pending},
+	{NULL, NULL}
+};
+
+LUALIB_API int luaopen_scheduler(lua_State* L) {
+	const luaL_Reg *l;
+	Scheduler *s;
+	int i;
+
+	lua_pushlightuserdata(L, &sched_key);
+	s = (Scheduler *)lua_newuserdata(L, sizeof(Scheduler));
+	memset(s, 0, sizeof(Scheduler));
+	s->free = NIL_NODE;
+	s->ready_head = s->ready_tail = NIL_NODE;
+	for (i = 0; i < WHEEL_SIZE; i++) {
+		s->wheel[i] = NIL_NODE;
+	}
+	lua_newtable(L);
+	s->anchor_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	lua_newtable(L);
+	s->events_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	lua_newtable(L);
+	lua_pushcfunction(L, sched_gc);
+	lua_setfield(L, -2, "__gc");
+	lua_setmetatable(L, -2);
+	lua_rawset(L, LUA_REGISTRYINDEX);
+
+	lua_newtable(L);
+	for (l = schedlib; l->name != NULL; l++) {
+		lua_pushcfunction(L, l->func);
+		lua_setfield(L, -2, l->name);
+	}
+	return 1;
+}
@@ -0,0 +1,134 @@
+/*
+ *Tencent is pleased to support the open source community by making xLua available.
+ *Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+ *Licensed under the MIT License (the "License"); you may not use this file except in compliance with the License. You may obtain a copy of the License at
+ *http://opensource.org/licenses/MIT
+ *Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the License for the specific language governing permissions and limitations under the License.
+*/
+
+/*
+** Checks xlua_pushutf16 against a plain reference encoder and times it:
+**
+**   utf16bench
+**
+** The check pushes 200k random strings mixing ASCII runs, 2 and 3 byte
+** characters, surrogate pairs and unpaired surrogates (which must become
+** U+FFFD, as with Encoding.UTF8). The timing pushes 1M strings (short
+** identifiers, CJK labels and 200+ character text) once through the
+** reference encoder plus lua_pushlstring and once through xlua_pushutf16.
+** Only the native side is measured: the managed Encoding.UTF8.GetBytes pass
+** and buffer copy that lua_pushstring no longer does are not part of it.
+*/
+
+#include "lua.h"
+#include "lauxlib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+LUA_API void luaopen_xlua(lua_State *L);
+LUA_API void xlua_pushutf16(lua_State *L, const uint16_t *s, int len);
+
+#define CHECK_COUNT 200000
+#define BENCH_COUNT 1000000
+#define BENCH_STRINGS 64
+
+/* one code point at a time, no fast paths */
+static size_t reference_encode(char *d, const uint16_t *s, size_t len) {
+	char *d0 = d;
+	size_t i;
+	for (i = 0; i < len; i++) {
+		uint32_t c = s[i];
+		if (c >= 0xd800 && c < 0xdc00 && i + 1 < len && s[i + 1] >= 0xdc00 && s[i + 1] < 0xe000) {
+			c = 0x10000 + ((c - 0xd800) << 10) + (s[++i] - 0xdc00);
+		} else if (c >= 0xd800 && c < 0xe000) {
+			c = 0xfffd;
+		}
+		if (c < 0x80) {
+			*d++ = (char)c;
+		} else if (c < 0x800) {
+			*d++ = (char)(0xc0 | (c >> 6));
+			*d++ = (char)(0x80 | (c & 0x3f));
+		} else if (c < 0x10000) {
+			*d++ = (char)(0xe0 | (c >> 12));
+			*d++ = (char)(0x80 | ((c >> 6) & 0x3f));
+			*d++ = (char)(0x80 | (c & 0x3f));
+		} else {
+			*d++ = (char)(0xf0 | (c >> 18));
+			*d++ = (char)(0x80 | ((c >> 12) & 0x3f));
+			*d++ = (char)(0x80 | ((c >> 6) & 0x3f));
+			*d++ = (char)(0x80 | (c & 0x3f));
+		}
+	}
+	return d - d0;
+}
+
+static int check(lua_State *L) {
+	static const uint16_t pool[] = {'a', 'Z', ' ', 0x7f, 0x80, 0xe9, 0x7ff, 0x800, 0x4e2d,
+		0xd83d, 0xde00, 0xdc00, 0xd800, 0xfffd, 0xffff};
+	static uint16_t buf[1500];
+	static char expected[1500 * 3];
+	int bad = 0, it, i;
+	srand(1);
+	for (it = 0; it < CHECK_COUNT; it++) {
+		int len = rand() % (it % 10 == 0 ? 1500 : 60);
+		int ascii = rand() % 3 == 0;
+		size_t n, elen;
+		const char *p;
+		for (i = 0; i < len; i++) {
+			buf[i] = (ascii && rand() % 50) ? (uint16_t)('a' + rand() % 26) : pool[rand() % (sizeof(pool) / sizeof(pool[0]))];
+		}
+		xlua_pushutf16(L, buf, len);
+		p = lua_tolstring(L, -1, &n);
+		elen = reference_encode(expected, buf, (size_t)len);
+		if (n != elen || memcmp(p, expected, n) != 0) {
+			bad++;
+		}
+		lua_pop(L, 1);
+	}
+	return bad;
+}
+
+static void bench(lua_State *L) {
+	static uint16_t strs[BENCH_STRINGS][300];
+	static int lens[BENCH_STRINGS];
+	static char tmp[300 * 3];
+	clock_t start;
+	double reference, native;
+	int i, j;
+	for (i = 0; i < BENCH_STRINGS; i++) {
+		lens[i] = i % 4 == 3 ? 200 + i : 8 + i % 24;
+		for (j = 0; j < lens[i]; j++) {
+			strs[i][j] = (uint16_t)(i % 4 == 1 ? 0x4e00 + (i * j) % 500 : 'a' + (i + j) % 26);
+		}
+	}
+	start = clock();
+	for (i = 0; i < BENCH_COUNT; i++) {
+		int k = i % BENCH_STRINGS;
+		lua_pushlstring(L, tmp, reference_encode(tmp, strs[k], (size_t)lens[k]));
+		lua_pop(L, 1);
+	}
+	reference = (double)(clock() - start) / CLOCKS_PER_SEC;
+	start = clock();
+	for (i = 0; i < BENCH_COUNT; i++) {
+		int k = i % BENCH_STRINGS;
+		xlua_pushutf16(L, strs[k], lens[k]);
+		lua_pop(L, 1);
+	}
+	native = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("%d strings: reference encode + lua_pushlstring %.3fs, xlua_pushutf16 %.3fs\n",
+		BENCH_COUNT, reference, native);
+}
+
+int main(void) {
+	lua_State *L = luaL_newstate();
+	int bad;
+	luaopen_xlua(L);
+	bad = check(L);
+	printf("%d strings checked, %d mismatches\n", CHECK_COUNT, bad);
+	bench(L);
+	lua_close(L);
+	return bad != 0;
+}
@@ -15,11 +15,27 @@
 #include <string.h>
 #include <stdint.h>
 #include "i64lib.h"
+#include "scheduler.h"
+#include "archive.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define XLUA_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define XLUA_NEON 1
+#endif
 
 #if USING_LUAJIT
 #include "lj_obj.h"
 #else
 #include "lstate.h"
+#include "lapi.h"
+#include "lgc.h"
+#include "lstring.h"
+#ifndef api_incr_top  /* 5.1 keeps it in lapi.c */
+#define api_incr_top(L)	(L->top++)
+#endif
 #endif
 
 /*
@@ -27,7 +43,23 @@
 */
 
 static int tag = 0;
-static const char *const hooknames[] = {"call", "return", "line", "count", "tail return"};
+
+/* constant keys interned once per state, see open_keys */
+static const char *const key_names[] = {"BaseType", "traceback", "[C#]",
+	"call", "return", "line", "count", "tail return"};
+
+enum {
+	KEY_BASETYPE,
+	KEY_TRACEBACK,
+	KEY_CSHARP,
+	KEY_HOOKNAMES,  /* hook event names, indexed by event */
+	KEY_COUNT = sizeof(key_names) / sizeof(key_names[0])
+};
+
+/* the handle table is reachable without a registry lookup */
+#if LUA_VERSION_NUM >= 503 && !USING_LUAJIT
+#define XLUA_FAST_HANDLES 1
+#endif
 static int hook_index = -1;
 
 LUA_API void *xlua_tag () 
@@ -189,6 +221,372 @@ LUA_API void xlua_getref_indirect(lua_State *L, int indirectRef, int reference)
 	lua_remove(L, -2);
 }
 
+/*
+** Handle table for the references C# keeps (LuaTable, LuaFunction, delegates).
+** Values sit in the array part of a table anchored in the registry; the free
+** list and a generation counter per slot are native, so ref/unref do not touch
+** the registry and a handle used after its unref is detected.
+** A handle is (generation << HANDLE_INDEX_BITS) | index, never 0 or negative.
+*/
+
+#define HANDLE_INDEX_BITS 20
+#define HANDLE_INDEX_MASK ((1 << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_GEN_MASK 0x7ff
+
+/* string cache for C#, see xlua_tolstring_cached; the size must match LuaDLL.cs */
+#define STRCACHE_BITS 10
+#define STRCACHE_SIZE (1 << STRCACHE_BITS)
+#define STRCACHE_MAXLEN 128
+
+typedef struct {
+	unsigned int gen;
+	int next;  /* next free slot, only meaningful while free */
+#if !USING_LUAJIT
+	int iskey;  /* made by xlua_key: `key' caches the interned string */
+	TValue key;
+#endif
+} HandleSlot;
+
+typedef struct {
+	int translator;  /* set by xlua_settranslator, must stay first: LuaDLL.cs reads it directly */
+	HandleSlot *slots;  /* 1-based, slots[0] unused */
+	int size;
+	int top;  /* highest index ever handed out */
+	int free;  /* first free slot, 0 for none */
+	int values_ref;
+	int keys[KEY_COUNT];  /* handles of the interned constant keys */
+	int strcache_ref;  /* table pinning the strings in `strcache' */
+	const char *strcache[STRCACHE_SIZE];
+#if XLUA_FAST_HANDLES
+	int structpool_ref;  /* set of the metatables whose free lists hold structs, see reuse_struct */
+	const void *structpool_last;  /* metatable last added to that set */
+	int structpooled;  /* number of structs on those free lists */
+	int structmisses;  /* struct pushes that reused nothing since the last one that did */
+#endif
+} HandleTable;
+
+static int handles_key = 0;
+
+static HandleTable *get_handles(lua_State *L) {
+#if XLUA_FAST_HANDLES
+	return *(HandleTable **)lua_getextraspace(L);
+#else
+	HandleTable *ht;
+	lua_pushlightuserdata(L, &handles_key);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	ht = (HandleTable *)lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	return ht;
+#endif
+}
+
+static int valid_handle(HandleTable *ht, int handle) {
+	int i = handle & HANDLE_INDEX_MASK;
+	return handle > 0 && i <= ht->top && ht->slots[i].gen == ((unsigned int)handle >> HANDLE_INDEX_BITS);
+}
+
+static HandleTable *check_handle(lua_State *L, int handle, int *idx) {
+	HandleTable *ht = get_handles(L);
+	if (!valid_handle(ht, handle)) {
+		return NULL;
+	}
+	*idx = handle & HANDLE_INDEX_MASK;
+	return ht;
+}
+
+static int handles_gc(lua_State *L) {
+	HandleTable *ht = (HandleTable *)lua_touserdata(L, 1);
+	void *ud;
+	lua_Alloc allocf = lua_getallocf(L, &ud);
+	allocf(ud, ht->slots, ht->size * sizeof(HandleSlot), 0);
+	ht->slots = NULL;
+	ht->size = ht->top = ht->free = 0;
+	return 0;
+}
+
+static void open_handles(lua_State *L) {
+	HandleTable *ht;
+	lua_pushlightuserdata(L, &handles_key);
+	ht = (HandleTable *)lua_newuserdata(L, sizeof(HandleTable));
+	memset(ht, 0, sizeof(HandleTable));
+	lua_newtable(L);
+	ht->values_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	lua_newtable(L);
+	lua_pushcfunction(L, handles_gc);
+	lua_setfield(L, -2, "__gc");
+	lua_setmetatable(L, -2);
+	lua_rawset(L, LUA_REGISTRYINDEX);
+#if XLUA_FAST_HANDLES
+	*(HandleTable **)lua_getextraspace(L) = ht;
+#endif
+}
+
+/* pops the value on the top of the stack and returns a handle to it, 0 for nil */
+LUA_API int xlua_ref(lua_State *L) {
+	HandleTable *ht = get_handles(L);
+	int i;
+	if (lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+		return 0;
+	}
+	if (ht->free != 0) {
+		i = ht->free;
+		ht->free = ht->slots[i].next;
+	} else {
+		if (ht->top >= HANDLE_INDEX_MASK) {
+			return luaL_error(L, "too many references");
+		}
+		if (ht->top + 1 >= ht->size) {
+			void *ud;
+			lua_Alloc allocf = lua_getallocf(L, &ud);
+			int size = ht->size ? ht->size * 2 : 256;
+			HandleSlot *slots;
+			slots = (HandleSlot *)allocf(ud, ht->slots, ht->size * sizeof(HandleSlot), size * sizeof(HandleSlot));
+			if (slots == NULL) {
+				return luaL_error(L, "not enough memory");
+			}
+			memset(slots + ht->size, 0, (size - ht->size) * sizeof(HandleSlot));
+			ht->slots = slots;
+			ht->size = size;
+		}
+		i = ++ht->top;
+	}
+	ht->slots[i].gen = (ht->slots[i].gen % HANDLE_GEN_MASK) + 1;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, ht->values_ref);
+	lua_insert(L, -2);
+	lua_rawseti(L, -2, i);
+	lua_pop(L, 1);
+	return (int)(ht->slots[i].gen << HANDLE_INDEX_BITS) | i;
+}
+
+/* pushes the referenced value; returns 0 (pushing nil) for a stale handle */
+LUA_API int xlua_getref(lua_State *L, int handle) {
+	int i;
+	HandleTable *ht = check_handle(L, handle, &i);
+	if (ht == NULL) {
+		lua_pushnil(L);
+		return 0;
+	}
+#if !USING_LUAJIT
+	if (ht->slots[i].iskey) {
+		setobj2s(L, L->top, &ht->slots[i].key);
+		api_incr_top(L);
+		return 1;
+	}
+#endif
+	lua_rawgeti(L, LUA_REGISTRYINDEX, ht->values_ref);
+	lua_rawgeti(L, -1, i);
+	lua_remove(L, -2);
+	return 1;
+}
+
+/* frees slot i; the values table is on the top of the stack */
+static void free_slot(lua_State *L, HandleTable *ht, int i) {
+	lua_pushboolean(L, 0);  /* keeps the array part dense */
+	lua_rawseti(L, -2, i);
+	ht->slots[i].gen = (ht->slots[i].gen % HANDLE_GEN_MASK) + 1;
+#if !USING_LUAJIT
+	ht->slots[i].iskey = 0;
+#endif
+	ht->slots[i].next = ht->free;
+	ht->free = i;
+}
+
+/* releases a handle; returns 0 if it was already stale */
+LUA_API int xlua_unref(lua_State *L, int handle) {
+	int i;
+	HandleTable *ht = check_handle(L, handle, &i);
+	if (ht == NULL) {
+		return 0;
+	}
+	lua_rawgeti(L, LUA_REGISTRYINDEX, ht->values_ref);
+	free_slot(L, ht, i);
+	lua_pop(L, 1);
+	return 1;
+}
+
+/* releases n handles at once; returns how many of them were not stale */
+LUA_API int xlua_unref_batch(lua_State *L, const int *handles, int n) {
+	HandleTable *ht = get_handles(L);
+	int k, released = 0;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, ht->values_ref);
+	for (k = 0; k < n; k++) {
+		if (valid_handle(ht, handles[k])) {
+			free_slot(L, ht, handles[k] & HANDLE_INDEX_MASK);
+			released++;
+		}
+	}
+	lua_pop(L, 1);
+	return released;
+}
+
+/*
+** Key handles: a string interned once and pinned by a handle, so getting or
+** setting a field with it neither re-hashes nor copies the name; the table
+** lookup compares the interned string by pointer. Release with xlua_unref.
+*/
+
+static int abs_index(lua_State *L, int idx) {
+	return (idx > 0 || idx <= LUA_REGISTRYINDEX) ? idx : lua_gettop(L) + idx + 1;
+}
+
+LUA_API int xlua_key(lua_State *L, const char *s, int len) {
+	int handle;
+	lua_pushlstring(L, s, len);
+	lua_pushvalue(L, -1);
+	handle = xlua_ref(L);
+#if !USING_LUAJIT
+	{
+		HandleSlot *slot = &get_handles(L)->slots[handle & HANDLE_INDEX_MASK];
+#if LUA_VERSION_NUM >= 504
+		setobj(L, &slot->key, s2v(L->top - 1));
+#else
+		setobj(L, &slot->key, L->top - 1);
+#endif
+		slot->iskey = 1;
+	}
+#endif
+	lua_pop(L, 1);
+	return handle;
+}
+
+/* pushes t[key] where t is the value at idx; returns the type of the result */
+LUA_API int xlua_getfield_key(lua_State *L, int idx, int key) {
+	idx = abs_index(L, idx);
+	xlua_getref(L, key);
+	lua_gettable(L, idx);
+	return lua_type(L, -1);
+}
+
+/* does t[key] = v where t is the value at idx and v the value on the top */
+LUA_API void xlua_setfield_key(lua_State *L, int idx, int key) {
+	idx = abs_index(L, idx);
+	xlua_getref(L, key);
+	lua_insert(L, -2);
+	lua_settable(L, idx);
+}
+
+/* without a fast way to reach the handles, interning would cost more than it saves */
+static void push_key(lua_State *L, int k) {
+#if XLUA_FAST_HANDLES
+	xlua_getref(L, get_handles(L)->keys[k]);
+#else
+	lua_pushstring(L, key_names[k]);
+#endif
+}
+
+static void getfield_key(lua_State *L, int idx, int k) {
+#if XLUA_FAST_HANDLES
+	xlua_getfield_key(L, idx, get_handles(L)->keys[k]);
+#else
+	lua_getfield(L, idx, key_names[k]);
+#endif
+}
+
+static void open_keys(lua_State *L) {
+	HandleTable *ht = get_handles(L);
+	int i;
+	for (i = 0; i < KEY_COUNT; i++) {
+		ht->keys[i] = xlua_key(L, key_names[i], (int)strlen(key_names[i]));
+	}
+}
+
+/*
+** String cache: C# keeps the managed string it decoded for each slot, and the
+** native side tells it when the Lua string in that slot is still the same one.
+** Cached strings are pinned by a table, so while a slot holds a pointer no other
+** string can live at that address. A sentinel finalized at every GC cycle drops
+** the whole cache, letting the strings go again.
+*/
+
+#define STR_HIT 1
+#define STR_ASCII 2
+
+static int str_isascii(const char *s, size_t len) {
+	const unsigned char *p = (const unsigned char *)s;
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+		uint64_t w;
+		memcpy(&w, p + i, sizeof(w));
+		if (w & UINT64_C(0x8080808080808080)) return 0;
+	}
+	for (; i < len; i++) {
+		if (p[i] & 0x80) return 0;
+	}
+	return 1;
+}
+
+static int strcache_slot(const char *s) {
+	return (int)(((uint32_t)((uintptr_t)s >> 3) * 2654435761u) >> (32 - STRCACHE_BITS));
+}
+
+static void new_strcache_sentinel(lua_State *L, int mt);
+
+static int strcache_gc(lua_State *L) {
+	HandleTable *ht = get_handles(L);
+	memset(ht->strcache, 0, sizeof(ht->strcache));
+	lua_createtable(L, STRCACHE_SIZE, 0);
+	lua_rawseti(L, LUA_REGISTRYINDEX, ht->strcache_ref);
+	lua_getmetatable(L, 1);
+	new_strcache_sentinel(L, lua_gettop(L));
+	return 0;
+}
+
+/* leaves an unreachable userdata behind, so strcache_gc runs at the next cycle */
+static void new_strcache_sentinel(lua_State *L, int mt) {
+	lua_newuserdata(L, 1);
+	if (mt == 0) {
+		lua_newtable(L);
+		lua_pushcfunction(L, strcache_gc);
+		lua_setfield(L, -2, "__gc");
+	} else {
+		lua_pushvalue(L, mt);
+	}
+	lua_setmetatable(L, -2);
+	lua_pop(L, 1);
+}
+
+static void open_strcache(lua_State *L) {
+	HandleTable *ht = get_handles(L);
+	lua_createtable(L, STRCACHE_SIZE, 0);
+	ht->strcache_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	new_strcache_sentinel(L, 0);
+}
+
+/*
+** like lua_tolstring; *slot is the cache slot of the string (-1 if it is not
+** cached) and *flags tells whether C# may reuse what it decoded for that slot
+** (STR_HIT) or, when not, whether the string is pure ASCII (STR_ASCII)
+*/
+LUA_API const char *xlua_tolstring_cached(lua_State *L, int idx, size_t *len, int *slot, int *flags) {
+	const char *s;
+	*slot = -1;
+	*flags = 0;
+	if (lua_type(L, idx) != LUA_TSTRING) {
+		s = lua_tolstring(L, idx, len);
+		if (s != NULL && str_isascii(s, *len)) *flags = STR_ASCII;
+		return s;
+	}
+	s = lua_tolstring(L, idx, len);
+	if (*len <= STRCACHE_MAXLEN) {
+		HandleTable *ht = get_handles(L);
+		int i = strcache_slot(s);
+		*slot = i;
+		if (ht->strcache[i] == s) {
+			*flags = STR_HIT;
+			return s;
+		}
+		idx = abs_index(L, idx);
+		lua_rawgeti(L, LUA_REGISTRYINDEX, ht->strcache_ref);
+		lua_pushvalue(L, idx);
+		lua_rawseti(L, -2, i + 1);
+		lua_pop(L, 1);
+		ht->strcache[i] = s;
+	}
+	if (str_isascii(s, *len)) *flags = STR_ASCII;
+	return s;
+}
+
 LUA_API int xlua_tointeger (lua_State *L, int idx) {
 	return (int)lua_tointeger(L, idx);
 }
@@ -201,11 +599,187 @@ LUA_API void xlua_pushlstring (lua_State *L, const char *s, int len) {
 	lua_pushlstring(L, s, len);
 }
 
+/*
+** UTF-16 (a C# string) to UTF-8, unpaired surrogates become U+FFFD as with
+** .NET's Encoding.UTF8. Runs of ASCII are checked and narrowed 8 units at a time.
+*/
+
+#define UTF16_STACKBUF 256
+
+static size_t utf16_ascii_prefix(const uint16_t *s, size_t len) {
+	size_t i = 0;
+#if XLUA_SSE2
+	const __m128i mask = _mm_set1_epi16((short)0xff80);
+	for (; i + 8 <= len; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, mask), _mm_setzero_si128())) != 0xffff) break;
+	}
+#elif XLUA_NEON
+	for (; i + 8 <= len; i += 8) {
+		if (vmaxvq_u16(vld1q_u16(s + i)) >= 0x80) break;
+	}
+#endif
+	for (; i + 4 <= len; i += 4) {
+		uint64_t w;
+		memcpy(&w, s + i, sizeof(w));
+		if (w & UINT64_C(0xff80ff80ff80ff80)) break;
+	}
+	while (i < len && s[i] < 0x80) i++;
+	return i;
+}
+
+static size_t utf16_ascii_copy(char *d, const uint16_t *s, size_t len) {
+	size_t i = 0;
+#if XLUA_SSE2
+	const __m128i mask = _mm_set1_epi16((short)0xff80);
+	for (; i + 8 <= len; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, mask), _mm_setzero_si128())) != 0xffff) break;
+		_mm_storel_epi64((__m128i *)(d + i), _mm_packus_epi16(v, v));
+	}
+#elif XLUA_NEON
+	for (; i + 8 <= len; i += 8) {
+		uint16x8_t v = vld1q_u16(s + i);
+		if (vmaxvq_u16(v) >= 0x80) break;
+		vst1_u8((uint8_t *)(d + i), vmovn_u16(v));
+	}
+#endif
+	for (; i < len && s[i] < 0x80; i++) {
+		d[i] = (char)s[i];
+	}
+	return i;
+}
+
+#define IS_HIGH_SURROGATE(c) ((c) >= 0xd800 && (c) < 0xdc00)
+#define IS_LOW_SURROGATE(c) ((c) >= 0xdc00 && (c) < 0xe000)
+
+static size_t utf16_utf8_size(const uint16_t *s, size_t len) {
+	size_t i = 0, size = 0;
+	for (;;) {
+		size_t n = utf16_ascii_prefix(s + i, len - i);
+		uint16_t c;
+		i += n;
+		size += n;
+		if (i >= len) break;
+		c = s[i++];
+		if (c < 0x800) {
+			size += 2;
+		} else if (IS_HIGH_SURROGATE(c) && i < len && IS_LOW_SURROGATE(s[i])) {
+			i++;
+			size += 4;
+		} else {
+			size += 3;
+		}
+	}
+	return size;
+}
+
+static void utf16_to_utf8(char *d, const uint16_t *s, size_t len) {
+	size_t i = 0;
+	for (;;) {
+		size_t n = utf16_ascii_copy(d, s + i, len - i);
+		uint32_t c;
+		i += n;
+		d += n;
+		if (i >= len) break;
+		c = s[i++];
+		if (c < 0x800) {
+			*d++ = (char)(0xc0 | (c >> 6));
+		} else {
+			if (IS_HIGH_SURROGATE(c) && i < len && IS_LOW_SURROGATE(s[i])) {
+				c = 0x10000 + ((c - 0xd800) << 10) + (s[i++] - 0xdc00);
+				*d++ = (char)(0xf0 | (c >> 18));
+				*d++ = (char)(0x80 | ((c >> 12) & 0x3f));
+			} else {
+				if (c >= 0xd800 && c < 0xe000) c = 0xfffd;
+				*d++ = (char)(0xe0 | (c >> 12));
+			}
+			*d++ = (char)(0x80 | ((c >> 6) & 0x3f));
+		}
+		*d++ = (char)(0x80 | (c & 0x3f));
+	}
+}
+
+/* pushes a C# string given as UTF-16, without an intermediate managed buffer */
+LUA_API void xlua_pushutf16 (lua_State *L, const uint16_t *s, int len) {
+	size_t size = utf16_utf8_size(s, (size_t)len);
+#if LUA_VERSION_NUM >= 503 && !USING_LUAJIT
+	if (size > LUAI_MAXSHORTLEN) {  /* long strings are not interned: write in place */
+		TString *ts;
+		lua_lock(L);
+		ts = luaS_createlngstrobj(L, size);
+		utf16_to_utf8(getstr(ts), s, (size_t)len);
+		setsvalue2s(L, L->top, ts);
+		api_incr_top(L);
+		luaC_checkGC(L);
+		lua_unlock(L);
+		return;
+	}
+#endif
+	if (size <= UTF16_STACKBUF) {
+		char buf[UTF16_STACKBUF];
+		utf16_to_utf8(buf, s, (size_t)len);
+		lua_pushlstring(L, buf, size);
+	} else {
+		char *buf = (char *)lua_newuserdata(L, size);
+		utf16_to_utf8(buf, s, (size_t)len);
+		lua_pushlstring(L, buf, size);
+		lua_remove(L, -2);
+	}
+}
+
 LUALIB_API int xluaL_loadbuffer (lua_State *L, const char *buff, int size,
                                 const char *name) {
 	return luaL_loadbuffer(L, buff, size, name);
 }
 
+/* index of the globals table, pushed on the stack where it is not a pseudo-index */
+static int push_globals(lua_State *L) {
+#if LUA_VERSION_NUM == 501
+	return LUA_GLOBALSINDEX;
+#else
+	lua_rawgeti(L, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+	return lua_gettop(L);
+#endif
+}
+
+/*
+** The p* wrappers below only need a protected call when a metamethod can run
+** or an error can be raised. A raw read is exact when the slot is already
+** present or the table has no metatable; a raw write is taken only when the
+** key is already present, so it never grows the table (which can fail on
+** memory) and nil or NaN keys go the protected way. Both skip lua_pcall;
+** idx must be absolute.
+*/
+static int fast_gettable(lua_State *L, int idx) {
+	if (lua_type(L, idx) != LUA_TTABLE) return 0;
+	if (!lua_getmetatable(L, idx)) {
+		lua_rawget(L, idx);
+		return 1;
+	}
+	lua_pop(L, 1);
+	lua_pushvalue(L, -1);
+	lua_rawget(L, idx);
+	if (lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+		return 0;
+	}
+	lua_remove(L, -2);
+	return 1;
+}
+
+static int fast_settable(lua_State *L, int idx) {
+	int present;
+	if (lua_type(L, idx) != LUA_TTABLE) return 0;
+	lua_pushvalue(L, -2);
+	lua_rawget(L, idx);
+	present = !lua_isnil(L, -1);
+	lua_pop(L, 1);
+	if (!present) return 0;
+	lua_rawset(L, idx);
+	return 1;
+}
+
 static int c_lua_gettable(lua_State* L) {    
     lua_gettable(L, 1);    
     return 1;
@@ -214,6 +788,7 @@ static int c_lua_gettable(lua_State* L) {
 LUA_API int xlua_pgettable(lua_State* L, int idx) {
     int top = lua_gettop(L);
     idx = lua_absindex(L, idx);
+    if (fast_gettable(L, idx)) return 0;
     lua_pushcfunction(L, c_lua_gettable);
     lua_pushvalue(L, idx);
     lua_pushvalue(L, top);
@@ -263,6 +838,7 @@ static int c_lua_settable(lua_State* L) {
 LUA_API int xlua_psettable(lua_State* L, int idx) {
     int top = lua_gettop(L);
     idx = lua_absindex(L, idx);
+    if (fast_settable(L, idx)) return 0;
     lua_pushcfunction(L, c_lua_settable);
     lua_pushvalue(L, idx);
     lua_pushvalue(L, top - 1);
@@ -316,6 +892,14 @@ static int c_lua_getglobal(lua_State* L) {
 }
 
 LUA_API int xlua_getglobal (lua_State *L, const char *name) {
+	int top = lua_gettop(L);
+	int globals = push_globals(L);
+	lua_pushstring(L, name);
+	if (fast_gettable(L, globals)) {
+		if (globals > 0) lua_remove(L, globals);
+		return 0;
+	}
+	lua_settop(L, top);
 	lua_pushcfunction(L, c_lua_getglobal);
 	lua_pushstring(L, name);
 	return lua_pcall(L, 1, 1, 0);
@@ -328,6 +912,14 @@ static int c_lua_setglobal(lua_State* L) {
 
 LUA_API int xlua_setglobal (lua_State *L, const char *name) {
 	int top = lua_gettop(L);
+	int globals = push_globals(L);
+	lua_pushstring(L, name);
+	lua_pushvalue(L, top);
+	if (fast_settable(L, globals)) {
+		lua_settop(L, top - 1);
+		return 0;
+	}
+	lua_settop(L, top);
 	lua_pushcfunction(L, c_lua_setglobal);
 	lua_pushstring(L, name);
 	lua_pushvalue(L, top);
@@ -355,9 +947,22 @@ static void cacheud(lua_State *L, int key, int cache_ref) {
 }
 
 
+#if LUA_VERSION_NUM >= 502
+#define raw_len(L, idx) lua_rawlen(L, idx)
+#else
+#define raw_len(L, idx) lua_objlen(L, idx)
+#endif
+
+/* proxy of a C# object; `destroyed' is set by xlua_markdestroyed */
+typedef struct {
+	int key;
+	int destroyed;
+} CSObject;
+
 LUA_API void xlua_pushcsobj(lua_State *L, int key, int meta_ref, int need_cache, int cache_ref) {
-	int* pointer = (int*)lua_newuserdata(L, sizeof(int));
-	*pointer = key;
+	CSObject *pointer = (CSObject *)lua_newuserdata(L, sizeof(CSObject));
+	pointer->key = key;
+	pointer->destroyed = 0;
 	
 	if (need_cache) cacheud(L, key, cache_ref);
 
@@ -366,6 +971,156 @@ LUA_API void xlua_pushcsobj(lua_State *L, int key, int meta_ref, int need_cache,
 	lua_setmetatable(L, -2);
 }
 
+static CSObject *to_csobject(lua_State *L, int idx) {
+	if (lua_type(L, idx) == LUA_TUSERDATA && raw_len(L, idx) == sizeof(CSObject)) {
+		CSObject *obj = (CSObject *)lua_touserdata(L, idx);
+		if (obj->key != -1 && obj->key != -2) return obj;  /* a struct, or a released one (see CSharpStruct) */
+	}
+	return NULL;
+}
+
+/*
+** flags the cached proxy of object `key' after C# saw the object destroyed, so
+** that indexing it fails at once; returns 0 if Lua has no proxy for it
+*/
+LUA_API int xlua_markdestroyed(lua_State *L, int key, int cache_ref) {
+	CSObject *obj;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, cache_ref);
+	lua_rawgeti(L, -1, key);
+	obj = to_csobject(L, -1);
+	lua_pop(L, 2);
+	if (obj == NULL || obj->key != key) {
+		return 0;
+	}
+	obj->destroyed = 1;
+	return 1;
+}
+
+static int is_destroyed(lua_State *L, int idx) {
+	CSObject *obj = to_csobject(L, idx);
+	return obj != NULL && obj->destroyed;
+}
+
+#define T_INT8   0
+#define T_UINT8  1
+#define T_INT16  2
+#define T_UINT16 3
+#define T_INT32  4
+#define T_UINT32 5
+#define T_INT64  6
+#define T_UINT64 7
+#define T_FLOAT  8
+#define T_DOUBLE 9
+#define T_BOOL   10  /* only for arrays */
+
+/*
+** Primitive C# arrays pinned by C# (see ObjectTranslator.Push) get a NativeArray
+** proxy instead of a bare object key, and arr[i] and arr.Length are served here;
+** other arrays, and released ones, go through the managed array callbacks.
+*/
+typedef struct {
+	int key;  /* first, as in every other C# object proxy */
+	int type;  /* T_INT8 .. T_DOUBLE, T_BOOL, or -1 once released */
+	int len;
+	void *data;
+} NativeArray;
+
+LUA_API void xlua_pusharray(lua_State *L, int key, int meta_ref, int need_cache, int cache_ref, void *data, int type, int len) {
+	NativeArray *a = (NativeArray *)lua_newuserdata(L, sizeof(NativeArray));
+	a->key = key;
+	a->type = type;
+	a->len = len;
+	a->data = data;
+
+	if (need_cache) cacheud(L, key, cache_ref);
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, meta_ref);
+
+	lua_setmetatable(L, -2);
+}
+
+static NativeArray *to_native_array(lua_State *L, int idx) {
+	if (lua_type(L, idx) == LUA_TUSERDATA && raw_len(L, idx) == sizeof(NativeArray)) {
+		NativeArray *a = (NativeArray *)lua_touserdata(L, idx);
+		if (a->type >= 0) return a;
+	}
+	return NULL;
+}
+
+/* called before C# unpins the array */
+LUA_API void xlua_releasearray(lua_State *L, int idx) {
+	NativeArray *a = to_native_array(L, idx);
+	if (a != NULL) a->type = -1;
+}
+
+static int native_array_index(lua_State *L, NativeArray *a) {
+	int i = xlua_tointeger(L, 2);
+	if (i < 0 || i >= a->len) {
+		return luaL_error(L, "index out of range! i =%d, array.Length=%d", i, a->len);
+	}
+	switch (a->type) {
+		case T_INT8: xlua_pushinteger(L, ((int8_t *)a->data)[i]); break;
+		case T_UINT8: xlua_pushinteger(L, ((uint8_t *)a->data)[i]); break;
+		case T_INT16: xlua_pushinteger(L, ((int16_t *)a->data)[i]); break;
+		case T_UINT16: xlua_pushinteger(L, ((uint16_t *)a->data)[i]); break;
+		case T_INT32: xlua_pushinteger(L, ((int32_t *)a->data)[i]); break;
+		case T_UINT32: xlua_pushuint(L, ((uint32_t *)a->data)[i]); break;
+		case T_INT64: lua_pushint64(L, ((int64_t *)a->data)[i]); break;
+		case T_UINT64: lua_pushuint64(L, ((uint64_t *)a->data)[i]); break;
+		case T_FLOAT: lua_pushnumber(L, ((float *)a->data)[i]); break;
+		case T_DOUBLE: lua_pushnumber(L, ((double *)a->data)[i]); break;
+		default: lua_pushboolean(L, ((uint8_t *)a->data)[i] != 0); break;
+	}
+	return 1;
+}
+
+/* returns 0 when the value does not fit the element type, for the managed path to handle */
+static int native_array_newindex(lua_State *L, NativeArray *a) {
+	int i;
+	switch (a->type) {
+		case T_BOOL: if (lua_type(L, 3) != LUA_TBOOLEAN) return 0; break;
+		case T_INT64: if (!lua_isint64(L, 3)) return 0; break;
+		case T_UINT64: if (!lua_isuint64(L, 3)) return 0; break;
+		default: if (lua_type(L, 3) != LUA_TNUMBER) return 0; break;
+	}
+	i = xlua_tointeger(L, 2);
+	if (i < 0 || i >= a->len) {
+		return luaL_error(L, "index out of range! i =%d, array.Length=%d", i, a->len);
+	}
+	switch (a->type) {
+		case T_INT8: ((int8_t *)a->data)[i] = (int8_t)xlua_tointeger(L, 3); break;
+		case T_UINT8: ((uint8_t *)a->data)[i] = (uint8_t)xlua_tointeger(L, 3); break;
+		case T_INT16: ((int16_t *)a->data)[i] = (int16_t)xlua_tointeger(L, 3); break;
+		case T_UINT16: ((uint16_t *)a->data)[i] = (uint16_t)xlua_tointeger(L, 3); break;
+		case T_INT32: ((int32_t *)a->data)[i] = (int32_t)xlua_tointeger(L, 3); break;
+		case T_UINT32: ((uint32_t *)a->data)[i] = xlua_touint(L, 3); break;
+		case T_INT64: ((int64_t *)a->data)[i] = lua_toint64(L, 3); break;
+		case T_UINT64: ((uint64_t *)a->data)[i] = lua_touint64(L, 3); break;
+		case T_FLOAT: ((float *)a->data)[i] = (float)lua_tonumber(L, 3); break;
+		case T_DOUBLE: ((double *)a->data)[i] = lua_tonumber(L, 3); break;
+		default: ((uint8_t *)a->data)[i] = (uint8_t)lua_toboolean(L, 3); break;
+	}
+	return 1;
+}
+
+//upvalue --- [1]: managed Length getter
+static int array_length(lua_State *L) {
+	NativeArray *a = to_native_array(L, 1);
+	if (a != NULL) {
+		xlua_pushinteger(L, a->len);
+		return 1;
+	}
+	lua_pushvalue(L, lua_upvalueindex(1));
+	lua_insert(L, 1);
+	lua_call(L, lua_gettop(L) - 1, 1);
+	return 1;
+}
+
+LUA_API int gen_array_length(lua_State *L) {
+	lua_pushcclosure(L, array_length, 1);
+	return 0;
+}
+
 void print_top(lua_State *L) {
 	lua_getglobal(L, "print");
 	lua_pushvalue(L, -2);
@@ -386,9 +1141,128 @@ void print_value(lua_State *L,  char *str, int idx) {
 	lua_call(L, 2, 0);
 }
 
-//upvalue --- [1]: methods, [2]:getters, [3]:csindexer, [4]:base, [5]:indexfuncs, [6]:arrayindexer, [7]:baseindex
+/*
+** Member index of a generated type, see xlua_pushmemberindex. Member names
+** are interned strings pinned by the values table, so while the index lives
+** a key string is one of its members exactly when it has the same address:
+** lookups hash the address instead of the characters and never touch the
+** methods/getters/setters tables. Strings Lua does not intern (long strings in
+** 5.3+) simply miss and take the usual path.
+*/
+#define MEMBER_METHOD 1
+#define MEMBER_GETTER 2
+#define MEMBER_SETTER 4
+
+typedef struct {
+	const void *key;  /* address of the interned name, NULL for an empty slot */
+	int member;  /* values[member + 1..3] hold the method, getter and setter */
+	int kinds;
+} MemberSlot;
+
+typedef struct {
+	int shift;  /* 32 - log2 of the slot count */
+	unsigned int mask;
+	MemberSlot slots[1];
+} MemberIndex;
+
+static unsigned int member_slot(const MemberIndex *mi, const void *key) {
+	return (unsigned int)(((unsigned int)((size_t)key >> 3) * 2654435769u) >> mi->shift);
+}
+
+static const MemberSlot *find_member(lua_State *L, int idx) {
+	const MemberIndex *mi = (const MemberIndex *)lua_touserdata(L, idx);
+	const void *key = lua_tostring(L, 2);
+	unsigned int i = member_slot(mi, key);
+	while (mi->slots[i].key != NULL) {
+		if (mi->slots[i].key == key) {
+			return &mi->slots[i];
+		}
+		i = (i + 1) & mi->mask;
+	}
+	return NULL;
+}
+
+/*
+** Pushes the member index of the `count' names and the table holding their
+** functions, taken from the methods/getters/setters tables at the given
+** indices (nil when the type has none). Both go to gen_obj_indexer_indexed
+** and gen_obj_newindexer_indexed.
+*/
+LUA_API void xlua_pushmemberindex(lua_State *L, int methods, int getters, int setters, const char **names, int count) {
+	int bits = 1, i, k, values;
+	size_t size;
+	MemberIndex *mi;
+	int tables[3];
+	tables[0] = lua_absindex(L, methods);
+	tables[1] = lua_absindex(L, getters);
+	tables[2] = lua_absindex(L, setters);
+	while ((1 << bits) < count * 2) bits++;  /* at most half full */
+	size = sizeof(MemberIndex) + ((1 << bits) - 1) * sizeof(MemberSlot);
+	mi = (MemberIndex *)lua_newuserdata(L, size);
+	memset(mi, 0, size);
+	mi->shift = 32 - bits;
+	mi->mask = (1u << bits) - 1;
+	lua_createtable(L, count * 3, count);
+	values = lua_gettop(L);
+	for (i = 0; i < count; i++) {
+		const void *key;
+		int kinds = 0;
+		unsigned int slot;
+		lua_pushstring(L, names[i]);
+		key = lua_tostring(L, -1);
+		for (k = 0; k < 3; k++) {
+			if (!lua_istable(L, tables[k])) continue;
+			lua_pushvalue(L, -1);
+			lua_rawget(L, tables[k]);
+			if (lua_isnil(L, -1)) {
+				lua_pop(L, 1);
+			} else {
+				lua_rawseti(L, values, i * 3 + k + 1);
+				kinds |= 1 << k;
+			}
+		}
+		lua_pushboolean(L, 1);
+		lua_rawset(L, values);  /* pins the name */
+		if (kinds == 0) continue;
+		slot = member_slot(mi, key);
+		while (mi->slots[slot].key != NULL && mi->slots[slot].key != key) {
+			slot = (slot + 1) & mi->mask;
+		}
+		mi->slots[slot].key = key;
+		mi->slots[slot].member = i * 3;
+		mi->slots[slot].kinds = kinds;
+	}
+}
+
+//upvalue --- [1]: methods, [2]:getters, [3]:csindexer, [4]:base, [5]:indexfuncs, [6]:arrayindexer, [7]:baseindex,
+//               [8]: member index, [9]: member values (both optional, see gen_obj_indexer_indexed)
 //param   --- [1]: obj, [2]: key
 LUA_API int obj_indexer(lua_State *L) {	
+	if (is_destroyed(L, 1)) {
+		return luaL_error(L, "attempt to index a destroyed c# object");
+	}
+
+	if (lua_type(L, 2) == LUA_TNUMBER && !lua_isnil(L, lua_upvalueindex(6))) {
+		NativeArray *a = to_native_array(L, 1);
+		if (a != NULL) {
+			return native_array_index(L, a);
+		}
+	}
+
+	if (lua_type(L, 2) == LUA_TSTRING && lua_type(L, lua_upvalueindex(8)) == LUA_TUSERDATA) {
+		const MemberSlot *m = find_member(L, lua_upvalueindex(8));
+		if (m != NULL && (m->kinds & MEMBER_METHOD)) {
+			lua_rawgeti(L, lua_upvalueindex(9), m->member + 1);
+			return 1;
+		}
+		if (m != NULL && (m->kinds & MEMBER_GETTER)) {
+			lua_rawgeti(L, lua_upvalueindex(9), m->member + 2);
+			lua_pushvalue(L, 1);
+			lua_call(L, 1, 1);
+			return 1;
+		}
+	}
+
 	if (!lua_isnil(L, lua_upvalueindex(1))) {
 		lua_pushvalue(L, 2);
 		lua_gettable(L, lua_upvalueindex(1));
@@ -441,7 +1315,7 @@ LUA_API int obj_indexer(lua_State *L) {
 				break;
 			}
 			lua_pop(L, 1);
-			lua_getfield(L, -1, "BaseType");
+			getfield_key(L, -1, KEY_BASETYPE);
 			lua_remove(L, -2);
 		}
 		lua_pushnil(L);
@@ -465,9 +1339,40 @@ LUA_API int gen_obj_indexer(lua_State *L) {
 	return 0;
 }
 
-//upvalue --- [1]:setters, [2]:csnewindexer, [3]:base, [4]:newindexfuncs, [5]:arrayindexer, [6]:basenewindex
+/* like gen_obj_indexer, with the two values from xlua_pushmemberindex on top */
+LUA_API int gen_obj_indexer_indexed(lua_State *L) {
+	lua_pushnil(L);
+	lua_insert(L, -3);
+	lua_pushcclosure(L, obj_indexer, 9);
+	return 0;
+}
+
+//upvalue --- [1]:setters, [2]:csnewindexer, [3]:base, [4]:newindexfuncs, [5]:arrayindexer, [6]:basenewindex,
+//               [7]: member index, [8]: member values (both optional, see gen_obj_newindexer_indexed)
 //param   --- [1]: obj, [2]: key, [3]: value
 LUA_API int obj_newindexer(lua_State *L) {
+	if (is_destroyed(L, 1)) {
+		return luaL_error(L, "attempt to index a destroyed c# object");
+	}
+
+	if (lua_type(L, 2) == LUA_TNUMBER && !lua_isnil(L, lua_upvalueindex(5))) {
+		NativeArray *a = to_native_array(L, 1);
+		if (a != NULL && native_array_newindex(L, a)) {
+			return 0;
+		}
+	}
+
+	if (lua_type(L, 2) == LUA_TSTRING && lua_type(L, lua_upvalueindex(7)) == LUA_TUSERDATA) {
+		const MemberSlot *m = find_member(L, lua_upvalueindex(7));
+		if (m != NULL && (m->kinds & MEMBER_SETTER)) {
+			lua_rawgeti(L, lua_upvalueindex(8), m->member + 3);
+			lua_pushvalue(L, 1);
+			lua_pushvalue(L, 3);
+			lua_call(L, 2, 0);
+			return 0;
+		}
+	}
+
 	if (!lua_isnil(L, lua_upvalueindex(1))) {
 		lua_pushvalue(L, 2);
 		lua_gettable(L, lua_upvalueindex(1));
@@ -513,7 +1418,7 @@ LUA_API int obj_newindexer(lua_State *L) {
 				break;
 			}
 			lua_pop(L, 1);
-			lua_getfield(L, -1, "BaseType");
+			getfield_key(L, -1, KEY_BASETYPE);
 			lua_remove(L, -2);
 		}
 		lua_pushnil(L);
@@ -537,6 +1442,14 @@ LUA_API int gen_obj_newindexer(lua_State *L) {
 	return 0;
 }
 
+/* like gen_obj_newindexer, with the two values from xlua_pushmemberindex on top */
+LUA_API int gen_obj_newindexer_indexed(lua_State *L) {
+	lua_pushnil(L);
+	lua_insert(L, -3);
+	lua_pushcclosure(L, obj_newindexer, 8);
+	return 0;
+}
+
 //upvalue --- [1]:getters, [2]:feilds, [3]:base, [4]:indexfuncs, [5]:baseindex
 //param   --- [1]: obj, [2]: key
 LUA_API int cls_indexer(lua_State *L) {	
@@ -571,7 +1484,7 @@ LUA_API int cls_indexer(lua_State *L) {
 				break;
 			}
 			lua_pop(L, 1);
-			lua_getfield(L, -1, "BaseType");
+			getfield_key(L, -1, KEY_BASETYPE);
 			lua_remove(L, -2);
 		}
 		lua_pushnil(L);
@@ -621,7 +1534,7 @@ LUA_API int cls_newindexer(lua_State *L) {
 				break;
 			}
 			lua_pop(L, 1);
-			lua_getfield(L, -1, "BaseType");
+			getfield_key(L, -1, KEY_BASETYPE);
 			lua_remove(L, -2);
 		}
 		lua_pushnil(L);
@@ -647,7 +1560,7 @@ LUA_API int gen_cls_newindexer(lua_State *L) {
 
 LUA_API int errorfunc(lua_State *L) {
 	lua_getglobal(L, "debug");
-	lua_getfield(L, -1, "traceback");
+	getfield_key(L, -1, KEY_TRACEBACK);
 	lua_remove(L, -2);
 	lua_pushvalue(L, 1);
 	lua_pushnumber(L, 2);
@@ -667,7 +1580,7 @@ LUA_API int load_error_func(lua_State *L, int ref) {
 
 LUA_API int pcall_prepare(lua_State *L, int error_func_ref, int func_ref) {
 	lua_rawgeti(L, LUA_REGISTRYINDEX, error_func_ref);
-	lua_rawgeti(L, LUA_REGISTRYINDEX, func_ref);
+	xlua_getref(L, func_ref);
 	return lua_gettop(L) - 1;
 }
 
@@ -679,7 +1592,7 @@ static void hook(lua_State *L, lua_Debug *ar)
 	lua_rawget(L, LUA_REGISTRYINDEX);
 
 	event = ar->event;
-	lua_pushstring(L, hooknames[event]);
+	push_key(L, KEY_HOOKNAMES + event);
   
 	lua_getinfo(L, "nS", ar);
 	if (*(ar->what) == 'C') {
@@ -706,9 +1619,9 @@ static void call_ret_hook(lua_State *L) {
 			return;
         }
 		
-		lua_pushliteral(L, "return");
+		push_key(L, KEY_HOOKNAMES + LUA_HOOKRET);
 		lua_pushfstring(L, "[?%s]", ar.name);
-		lua_pushliteral(L, "[C#]");
+		push_key(L, KEY_CSHARP);
 		
 		lua_sethook(L, 0, 0, 0);
 		lua_call(L, 3, 0);
@@ -822,14 +1735,120 @@ LUALIB_API int xlua_csharp_error(lua_State* L)
     return 1;
 }
 
+/* fake_id is -1, or RELEASED_STRUCT once xlua.structrelease took the struct */
 typedef struct {
 	int fake_id;
     unsigned int len;
 	char data[1];
 } CSharpStruct;
 
+#define RELEASED_STRUCT -2
+
+#if XLUA_FAST_HANDLES
+
+#define STRUCTPOOL_MAX 64  /* released structs kept per type */
+#define STRUCTPOOL_MISSES 256  /* pushes reusing nothing before the free lists are dropped */
+
+/* empties all free lists, the structs on them stay released and get collected */
+static void drop_struct_pools(lua_State *L, HandleTable *ht) {
+	int n;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, ht->structpool_ref);
+	lua_pushnil(L);
+	while (lua_next(L, -2)) {
+		lua_pop(L, 1);
+		for (n = (int)raw_len(L, -1); n > 1; n--) {
+			lua_pushnil(L);
+			lua_rawseti(L, -3, n);
+		}
+	}
+	lua_pop(L, 1);
+	lua_newtable(L);
+	lua_rawseti(L, LUA_REGISTRYINDEX, ht->structpool_ref);
+	ht->structpool_last = NULL;
+	ht->structpooled = 0;
+	ht->structmisses = 0;
+}
+
+static void open_structpool(lua_State *L) {
+	lua_newtable(L);
+	get_handles(L)->structpool_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+/*
+** Per-type free lists of struct userdata: xlua.structrelease(v) hands v back,
+** and the next push of that type (last released first) writes into it instead
+** of allocating. Releasing a struct right before a call thus makes it the
+** target of the struct the call returns. The list lives in the array part of
+** the type's metatable, after the type id at [1]. Pushes the reused struct,
+** or returns NULL when there is none. When released structs pile up on lists
+** nobody pushes from, the lists are dropped after STRUCTPOOL_MISSES pushes,
+** so that pushes stop paying for the lookup.
+*/
+static CSharpStruct *reuse_struct(lua_State *L, unsigned int size, int meta_ref) {
+	HandleTable *ht = get_handles(L);
+	CSharpStruct *css;
+	int n;
+	if (ht->structpooled == 0) {
+		return NULL;
+	}
+	lua_rawgeti(L, LUA_REGISTRYINDEX, meta_ref);
+	if ((n = (int)raw_len(L, -1)) > 1) {
+		lua_rawgeti(L, -1, n);
+		lua_pushnil(L);
+		lua_rawseti(L, -3, n);
+		lua_remove(L, -2);
+		ht->structpooled--;
+		css = (CSharpStruct *)lua_touserdata(L, -1);
+		if (css->len == size) {
+			css->fake_id = -1;
+			ht->structmisses = 0;
+			return css;
+		}
+	}
+	lua_pop(L, 1);  /* nothing there, or the type changed size */
+	if (++ht->structmisses >= STRUCTPOOL_MISSES) {
+		drop_struct_pools(L, ht);
+	}
+	return NULL;
+}
+
+/* puts the released struct at 1 on the free list of its metatable, at the top */
+static void pool_struct(lua_State *L) {
+	HandleTable *ht = get_handles(L);
+	int n = (int)raw_len(L, -1);
+	if (n > STRUCTPOOL_MAX) {
+		return;
+	}
+	lua_pushvalue(L, 1);
+	lua_rawseti(L, -2, n + 1);
+	if (lua_topointer(L, -1) != ht->structpool_last) {
+		ht->structpool_last = lua_topointer(L, -1);
+		lua_rawgeti(L, LUA_REGISTRYINDEX, ht->structpool_ref);
+		lua_pushvalue(L, -2);
+		lua_pushboolean(L, 1);
+		lua_rawset(L, -3);
+	}
+	ht->structpooled++;
+}
+
+#else
+
+/*
+** without a fast way to reach the handles, every struct push would pay a
+** registry lookup for the pool check, so released structs are just dropped
+*/
+#define open_structpool(L)	((void)0)
+#define reuse_struct(L, size, meta_ref)	NULL
+#define pool_struct(L)	((void)0)
+
+#endif
+
 LUA_API void *xlua_pushstruct(lua_State *L, unsigned int size, int meta_ref) {
-	CSharpStruct *css = (CSharpStruct *)lua_newuserdata(L, size + sizeof(int) + sizeof(unsigned int));
+	CSharpStruct *css = reuse_struct(L, size, meta_ref);
+	if (css != NULL) {
+		return css;
+	}
+	css = (CSharpStruct *)lua_newuserdata(L, size + sizeof(int) + sizeof(unsigned int));
 	css->fake_id = -1;
 	css->len = size;
     lua_rawgeti(L, LUA_REGISTRYINDEX, meta_ref);
@@ -844,7 +1863,11 @@ LUA_API void xlua_pushcstable(lua_State *L, unsigned int size, int meta_ref) {
 }
 
 LUA_API void *xlua_newstruct(lua_State *L, int size, int meta_ref) {
-	CSharpStruct *css = (CSharpStruct *)lua_newuserdata(L, size + sizeof(int) + sizeof(unsigned int));
+	CSharpStruct *css = reuse_struct(L, (unsigned int)size, meta_ref);
+	if (css != NULL) {
+		return css->data;
+	}
+	css = (CSharpStruct *)lua_newuserdata(L, size + sizeof(int) + sizeof(unsigned int));
 	css->fake_id = -1;
 	css->len = size;
     lua_rawgeti(L, LUA_REGISTRYINDEX, meta_ref);
@@ -854,7 +1877,7 @@ LUA_API void *xlua_newstruct(lua_State *L, int size, int meta_ref) {
 
 LUA_API void *xlua_tostruct(lua_State *L, int idx, int meta_ref) {
 	CSharpStruct *css = (CSharpStruct *)lua_touserdata(L, idx);
-	if (NULL != css) {
+	if (NULL != css && css->fake_id != RELEASED_STRUCT) {
 		if (lua_getmetatable (L, idx)) {
 			lua_rawgeti(L, -1, 1);
 			if (lua_type(L, -1) == LUA_TNUMBER && (int)lua_tointeger(L, -1) == meta_ref) {
@@ -881,6 +1904,28 @@ LUA_API int xlua_gettypeid(lua_State *L, int idx) {
 	return type_id;
 }
 
+/*
+** Describes the arguments of a C# overloaded method in one call, for the
+** overload cache in MethodWarpsCache.cs: sig[i] is the lua_type of argument i+1,
+** or 16 + its type id for userdata. Returns the number of arguments, or -1 when
+** there are more than `max' or a userdata can not be described by its type id
+** (no id, or a destroyed C# object), then the overloads must be checked one by one.
+*/
+LUA_API int xlua_argsignature(lua_State *L, int *sig, int max) {
+	int i, n = lua_gettop(L);
+	if (n > max) return -1;
+	for (i = 1; i <= n; i++) {
+		int t = lua_type(L, i);
+		if (t == LUA_TUSERDATA) {
+			int type_id = xlua_gettypeid(L, i);
+			if (type_id < 0 || is_destroyed(L, i)) return -1;
+			t = 16 + type_id;
+		}
+		sig[i - 1] = t;
+	}
+	return n;
+}
+
 #define PACK_UNPACK_OF(type) \
 LUALIB_API int xlua_pack_##type(void *p, int offset, type field) {\
 	CSharpStruct *css = (CSharpStruct *)p;\
@@ -1096,16 +2141,6 @@ LUA_API int xlua_is_eq_str(lua_State *L, int idx, const char* str, int str_len)
 	}
 }
 
-#define T_INT8   0
-#define T_UINT8  1
-#define T_INT16  2
-#define T_UINT16 3
-#define T_INT32  4
-#define T_UINT32 5
-#define T_INT64  6
-#define T_UINT64 7
-#define T_FLOAT  8
-#define T_DOUBLE 9
 
 #define DIRECT_ACCESS(type, push_func, to_func) \
 int xlua_struct_get_##type(lua_State *L) {\
@@ -1192,8 +2227,12 @@ LUA_API int gen_css_access(lua_State *L) {
 	return 3;
 }
 
+static int is_released_struct(lua_State *L, int idx) {
+	return raw_len(L, idx) >= sizeof(int) && ((CSharpStruct *)lua_touserdata(L, idx))->fake_id == RELEASED_STRUCT;
+}
+
 static int is_cs_data(lua_State *L, int idx) {
-	if (LUA_TUSERDATA == lua_type(L, idx) && lua_getmetatable(L, idx)) {
+	if (LUA_TUSERDATA == lua_type(L, idx) && !is_released_struct(L, idx) && lua_getmetatable(L, idx)) {
 		lua_pushlightuserdata(L, &tag);
 		lua_rawget(L,-2);
 		if (!lua_isnil (L,-1)) {
@@ -1221,25 +2260,76 @@ LUA_API int css_clone(lua_State *L) {
 	return 1;
 }
 
+/*
+** xlua.structrelease(v): puts struct v on the free list of its type (only
+** where the free lists are compiled in, see reuse_struct); v is marked
+** released, so using or releasing it again fails until a push reuses it
+*/
+static int css_release(lua_State *L) {
+	CSharpStruct *css = (CSharpStruct *)lua_touserdata(L, 1);
+	if (lua_type(L, 1) == LUA_TUSERDATA && is_released_struct(L, 1)) {
+		return luaL_error(L, "c# struct already released!");
+	}
+	if (!is_cs_data(L, 1) || css->fake_id != -1 || !lua_getmetatable(L, 1)) {
+		return luaL_error(L, "invalid c# struct!");
+	}
+	lua_rawgeti(L, -1, 1);
+	if (lua_type(L, -1) != LUA_TNUMBER) {
+		return luaL_error(L, "invalid c# struct!");
+	}
+	lua_pop(L, 1);
+	css->fake_id = RELEASED_STRUCT;
+	pool_struct(L);
+	return 0;
+}
+
 LUA_API void* xlua_gl(lua_State *L) {
 	return G(L);
 }
 
+/*
+** Stores the id of the C# translator owning this state. Where the handle table
+** pointer lives in the extra space (copied to every new thread) C# can read the
+** id straight from L, without a call into native code; returns 1 in that case,
+** 0 when it has to keep mapping xlua_gl to translators itself.
+*/
+LUA_API int xlua_settranslator(lua_State *L, int id) {
+	get_handles(L)->translator = id;
+#if XLUA_FAST_HANDLES
+	return LUA_EXTRASPACE == sizeof(void *);
+#else
+	return 0;
+#endif
+}
+
 static const luaL_Reg xlualib[] = {
 	{"sethook", profiler_set_hook},
 	{"genaccessor", gen_css_access},
 	{"structclone", css_clone},
+	{"structrelease", css_release},
 	{NULL, NULL}
 };
 
 LUA_API void luaopen_xlua(lua_State *L) {
 	luaL_openlibs(L);
+	open_handles(L);
+	open_keys(L);
+	open_strcache(L);
+	open_structpool(L);
 	
 #if LUA_VERSION_NUM >= 503
 	luaL_newlib(L, xlualib);
+	luaopen_scheduler(L);
+	lua_setfield(L, -2, "scheduler");
+	luaopen_archive(L);
+	lua_setfield(L, -2, "archive");
 	lua_setglobal(L, "xlua");
 #else
 	luaL_register(L, "xlua", xlualib);
+	luaopen_scheduler(L);
+	lua_setfield(L, -2, "scheduler");
+	luaopen_archive(L);
+	lua_setfield(L, -2, "archive");
     lua_pop(L, 1);
 #endif
 }
@@ -0,0 +1,93 @@
+/*
+ *Tencent is pleased to support the open source community by making xLua available.
+ *Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+ *Licensed under the MIT License (the "License"); you may not use this file except in compliance with the License. You may obtain a copy of the License at
+ *http://opensource.org/licenses/MIT
+ *Unless required by applicable law or agreed to in writing, software distributed under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the License for the specific language governing permissions and limitations under the License.
+*/
+
+/*
+** Packs scripts into an archive for xlua.archive:
+**
+**   xluapack [-z] archive file...
+**
+** -z compresses the chunks with LZ4. Module names come from the file paths:
+** a leading "./" and everything from the first '.' of the file name on are
+** dropped and directory separators become dots, so a/b/c.lua.txt is packed
+** as a.b.c.
+*/
+
+#include "archive.h"
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned char *read_file(const char *path, size_t *size) {
+	unsigned char *buf;
+	long len;
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) return NULL;
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	buf = (unsigned char *)malloc(len > 0 ? (size_t)len : 1);
+	if (buf != NULL && len > 0 && fread(buf, 1, (size_t)len, f) != (size_t)len) {
+		free(buf);
+		buf = NULL;
+	}
+	fclose(f);
+	*size = len > 0 ? (size_t)len : 0;
+	return buf;
+}
+
+static char *module_name(const char *path, size_t *len) {
+	char *name, *p, *base;
+	while (path[0] == '.' && (path[1] == '/' || path[1] == '\\')) path += 2;
+	name = (char *)malloc(strlen(path) + 1);
+	if (name == NULL) return NULL;
+	strcpy(name, path);
+	base = name;
+	for (p = name; *p; p++) {
+		if (*p == '/' || *p == '\\') {
+			*p = '.';
+			base = p + 1;
+		}
+	}
+	p = strchr(base, '.');
+	if (p != NULL) *p = '\0';
+	*len = strlen(name);
+	return name;
+}
+
+int main(int argc, char **argv) {
+	XArchiveFile *files;
+	const char *out;
+	FILE *f;
+	int i, n = 0, compress = 0, first = 1;
+
+	if (argc > 1 && strcmp(argv[1], "-z") == 0) {
+		compress = 1;
+		first++;
+	}
+	if (argc <= first) {
+		fprintf(stderr, "usage: %s [-z] archive file...\n", argv[0]);
+		return 1;
+	}
+	out = argv[first++];
+	files = (XArchiveFile *)malloc(sizeof(XArchiveFile) * (argc > first ? argc - first : 1));
+	if (files == NULL) return 1;
+	for (i = first; i < argc; i++, n++) {
+		files[n].data = read_file(argv[i], &files[n].size);
+		files[n].name = module_name(argv[i], &files[n].name_len);
+		if (files[n].data == NULL || files[n].name == NULL) {
+			fprintf(stderr, "cannot read %s\n", argv[i]);
+			return 1;
+		}
+	}
+	f = fopen(out, "wb");
+	if (f == NULL || xarchive_write(f, files, n, compress) != 0 || fclose(f) != 0) {
+		fprintf(stderr, "cannot write %s (duplicated module names?)\n", out);
+		return 1;
+	}
+	printf("%d files packed into %s\n", n, out);
+	return 0;
+}